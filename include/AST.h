@@ -1,19 +1,74 @@
 /* AST.h */
 
 #pragma once
+#include "closure.h"
 #include "object.h"
 #include "parser.h"
 #include "scope.h"
+#include <cstdint>
 #include <vector>
 
 class CodeBlock;
 class Statement;
 class ASTNode;
+class IDNode;
 class Object;
 class Scope;
+class Compiler;
+class Resolver;
+class Optimizer;
+class ClosureCompiler;
+class Fuser;
+class LoopOptimizer;
+class Effects;
+class HoistedNode;
 enum class OperatorType;
 
 Object& checkLval(const Object& obj);
+// Functions and methods return either an object that lives elsewhere (an lvalue) or
+// a new object owned by the caller. The latter is moved to tmp and deleted.
+Object* takeResult(Object* result, Object& tmp);
+// Stores a changed element of a packed array back (see Object::storeBack). A result
+// that is the element is copied to tmp first, as the proxy is freed.
+Object* storeBack(Object* changed, Object* result, Object& tmp);
+
+// The operators of the nodes, applied to their evaluated operands. The result is
+// either tmp or an operand (i.e. the lhs of an assignment). nullptr if the operator
+// isn't one of the node's.
+using BinaryOperator = Object* (*)(Object* oLeft, Object* oRight, Object& rightTmp,
+                                   Object& tmp);
+using UnaryOperator = Object* (*)(Object* operand, Object& tmp);
+BinaryOperator binaryOperator(OperatorType);
+// Like binaryOperator(), but operands that are both ints or both floats are handled
+// directly first, like in a quickened node
+BinaryOperator numericalOperator(OperatorType);
+UnaryOperator unaryOperator(OperatorType);
+
+/* The loop of a counted for statement, whose limits can't change (see loops.h). While
+ * the counter and the upper limit are ints, the counter is compared and incremented
+ * directly in its slot. body() runs an iteration, the loop stops when it returns
+ * something (i.e. a return statement ran). */
+template <typename Body>
+Object* countedLoop(Object& counter, Object& upper, const Body& body)
+{
+	const int* upperInt = std::get_if<int>(&upper.data);
+	const int last = (upperInt) ? (*upperInt) : (0);
+	Object* result = nullptr;
+	while (true)
+	{
+		// The body may assign to the counter, so its type is checked every time
+		int* i = std::get_if<int>(&counter.data);
+		if (i && upperInt)
+		{
+			if (*i > last) break;
+		}
+		else if (!(counter <= upper).isTrue()) break;
+		if ((result = body()) != nullptr) break;
+		if ((i = std::get_if<int>(&counter.data))) ++*i;
+		else ++counter;
+	}
+	return result;
+}
 
 
 /* Everything is inside a codeblock. A codeblock contains statements. Statements may be
@@ -49,9 +104,19 @@ public:
 	CodeBlock();
 	~CodeBlock();
 	Object* eval(Scope*, bool isInFunction) const;
+	void compile(Compiler&) const; // Lowers the block to bytecode
+	void resolve(Resolver&); // Binds the identifiers to slots
+	void fold(Optimizer&); // Folds the constant expressions (-O1)
+	StmtClosure close(ClosureCompiler&); // Turns the block into a closure (-c)
+	void fuse(Fuser&); // Replaces common trees with fused nodes
+	void optimizeLoops(LoopOptimizer&); // Finds the counted loops and hoists code
+	void hoist(LoopOptimizer&); // Hoists the invariant expressions of an enclosing loop
+	void addEffects(Effects&) const; // The variables read and assigned to, and calls
 	void addStatement(Statement*);
+	[[nodiscard]] size_t getSlotCount() const;
 private:
 	std::vector<Statement*> statementVec{};
+	size_t nSlots = 0; // Slots in the block's frame, set by the resolver
 };
 
 class Statement
@@ -62,6 +127,14 @@ public:
 	virtual Object* eval(Scope*, bool isInFunction);
 	// Is in function is used to determine whether a return statement is valid.
 	// (return is invalid outside a function)
+	virtual void compile(Compiler&) const; // Emits the statement's bytecode
+	virtual void resolve(Resolver&);
+	virtual void fold(Optimizer&);
+	virtual StmtClosure close(ClosureCompiler&);
+	virtual void fuse(Fuser&);
+	virtual void optimizeLoops(LoopOptimizer&);
+	virtual void hoist(LoopOptimizer&);
+	virtual void addEffects(Effects&) const;
 protected:
 	size_t pos = 0; // Holds the position of the statement in the source code
 };
@@ -74,6 +147,14 @@ public:
 	explicit IfStatement(size_t); // Contructor argument is the location in code
 	IfStatement(ASTNode*, CodeBlock*, size_t);
 	Object* eval(Scope*, bool isInFunction) override;
+	void compile(Compiler&) const override;
+	void resolve(Resolver&) override;
+	void fold(Optimizer&) override;
+	StmtClosure close(ClosureCompiler&) override;
+	void fuse(Fuser&) override;
+	void optimizeLoops(LoopOptimizer&) override;
+	void hoist(LoopOptimizer&) override;
+	void addEffects(Effects&) const override;
 	void addCase(ASTNode*, CodeBlock*);
 	// A 'case' is a branch in an if - elif - else chain. The minimum is 2
 	// cases (an if and an else).
@@ -89,9 +170,18 @@ public:
 	// Requires a condition, a block, and the location in code
 	WhileStatement(ASTNode*, CodeBlock*, size_t);
 	Object* eval(Scope*, bool isInFunction) override;
+	void compile(Compiler&) const override;
+	void resolve(Resolver&) override;
+	void fold(Optimizer&) override;
+	StmtClosure close(ClosureCompiler&) override;
+	void fuse(Fuser&) override;
+	void optimizeLoops(LoopOptimizer&) override;
+	void hoist(LoopOptimizer&) override;
+	void addEffects(Effects&) const override;
 private:
 	ASTNode* condition = nullptr;
 	CodeBlock* block = nullptr;
+	std::vector<HoistedNode*> hoisted{}; // Set by the loop optimizer
 };
 
 class ForStatement final : public Statement
@@ -102,11 +192,21 @@ public:
 	// Requires the counter var. node, the conditions, block, and location
 	ForStatement(ASTNode*, ASTNode*, ASTNode*, CodeBlock*, size_t);
 	Object* eval(Scope*, bool isInFunction) override;
+	void compile(Compiler&) const override;
+	void resolve(Resolver&) override;
+	void fold(Optimizer&) override;
+	StmtClosure close(ClosureCompiler&) override;
+	void fuse(Fuser&) override;
+	void optimizeLoops(LoopOptimizer&) override;
+	void hoist(LoopOptimizer&) override;
+	void addEffects(Effects&) const override;
 private:
 	ASTNode* counterNode = nullptr;
 	ASTNode* lowerNode = nullptr; // Refers to the lower limit of a for range
 	ASTNode* upperNode = nullptr; // Upper limit
 	CodeBlock* block = nullptr;
+	bool counted = false; // The limits can't change, set by the loop optimizer
+	std::vector<HoistedNode*> hoisted{};
 };
 
 class ExprStatement final : public Statement
@@ -117,6 +217,14 @@ public:
 	// Requires simply a pointer to an expression tree, and its location in code
 	ExprStatement(ASTNode*, size_t);
 	Object* eval(Scope*, bool isInFunction) override;
+	void compile(Compiler&) const override;
+	void resolve(Resolver&) override;
+	void fold(Optimizer&) override;
+	StmtClosure close(ClosureCompiler&) override;
+	void fuse(Fuser&) override;
+	void optimizeLoops(LoopOptimizer&) override;
+	void hoist(LoopOptimizer&) override;
+	void addEffects(Effects&) const override;
 private:
 	ASTNode* exprRoot = nullptr;
 };
@@ -128,6 +236,14 @@ public:
 	~ReturnStatement() override;
 	ReturnStatement(ASTNode*, size_t);
 	Object* eval(Scope*, bool isInFunction) override;
+	void compile(Compiler&) const override;
+	void resolve(Resolver&) override;
+	void fold(Optimizer&) override;
+	StmtClosure close(ClosureCompiler&) override;
+	void fuse(Fuser&) override;
+	void optimizeLoops(LoopOptimizer&) override;
+	void hoist(LoopOptimizer&) override;
+	void addEffects(Effects&) const override;
 	// if isInFunction is false, eval() cannot be executed as return statements
 	// can only be within functions
 private:
@@ -143,6 +259,13 @@ public:
 	// a codeblock and its location
 	FunctionDefStatement(ASTNode*, std::vector<ASTNode*>, CodeBlock*, size_t);
 	Object* eval(Scope*, bool) override;
+	void compile(Compiler&) const override;
+	void resolve(Resolver&) override;
+	void fold(Optimizer&) override;
+	StmtClosure close(ClosureCompiler&) override;
+	void fuse(Fuser&) override;
+	void optimizeLoops(LoopOptimizer&) override;
+	void addEffects(Effects&) const override;
 private:
 	ASTNode* funcID = nullptr; // An ID node used to name the function
 	std::vector<ASTNode*> funcParams{}; // ID nodes - the parameters
@@ -155,10 +278,45 @@ class ASTNode // Base class for nodes
 public:
 	ASTNode();
 	virtual ~ASTNode(); // Destructor is virtual
-	virtual Object* eval(Scope*, bool lSide = false);
+	/* The result is either an object that lives elsewhere (i.e. a variable), which is
+	 * borrowed, or a temporary stored in tmp, which is owned by the caller. A call of a
+	 * function that returns nothing gives nullptr. */
+	virtual Object* eval(Scope*, Object& tmp, bool lSide = false);
+	// Calls the node's value with args. calleeTmp holds the callee if it's temporary.
+	// The result is like the one of a function (see takeResult() in AST.cpp)
+	virtual Object* call(Scope*, Object& calleeTmp, Args args);
+	// Emits bytecode that leaves the node's result in register dst
+	virtual void compile(Compiler&, int dst, bool lSide = false) const;
+	// Emits a call of the node's value, with the nArgs arguments after register base
+	virtual void compileCall(Compiler&, int base, uint32_t nArgs, size_t callPos) const;
+	// lSide has the same meaning as in eval()
+	virtual void resolve(Resolver&, bool lSide = false);
+	// Returns the node that replaces this one, i.e. a literal with its value
+	virtual ASTNode* fold(Optimizer&);
+	// The closure evaluating the node, lSide has the same meaning as in eval()
+	virtual ExprClosure close(ClosureCompiler&, bool lSide = false);
+	virtual CallClosure closeCall(ClosureCompiler&); // Calls the node's value
+	// Returns the node that replaces this one, a fused node (see fuser.h) or itself
+	virtual ASTNode* fuse(Fuser&);
+	virtual void addEffects(Effects&) const; // See effects.h
+	// Replaces the operands with the nodes returned by LoopOptimizer::hoist()
+	virtual void hoistOperands(LoopOptimizer&);
+	[[nodiscard]] virtual bool isCall() const; // Calls may return nothing
+	[[nodiscard]] virtual bool isMethod() const; // Member access, i.e. S.push
+	// Evaluating the node changes nothing, it has no assignments or calls other than
+	// the ones of methods that change nothing, i.e. A.size()
+	[[nodiscard]] virtual bool isPure() const;
+	// A method that changes nothing, of a receiver that has no side effects
+	[[nodiscard]] virtual bool isPureMethod() const;
 	void setForceRval(bool);
+	[[nodiscard]] bool isForceRval() const;
+	// The node's value is changed in place, i.e. A[0] in A[0] = 1. A container it is
+	// in is then unshared first (see Object::unshare)
+	virtual void setWritten();
+	[[nodiscard]] size_t getPos() const;
 protected:
 	bool forceRval = false;
+	bool written = false;
 	size_t pos = 0;
 };
 
@@ -169,13 +327,39 @@ public:
 	nAryNode();
 	~nAryNode() override;
 	nAryNode(ASTNode*, OperatorType, std::vector<ASTNode*>, size_t);
-	Object* eval(Scope* scope, bool lSide = false) override;
+	Object* eval(Scope* scope, Object& tmp, bool lSide = false) override;
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+	ASTNode* fold(Optimizer&) override;
+	ExprClosure close(ClosureCompiler&, bool lSide = false) override;
+	ASTNode* fuse(Fuser&) override;
+	void addEffects(Effects&) const override;
+	void hoistOperands(LoopOptimizer&) override;
+	[[nodiscard]] bool isCall() const override;
+	[[nodiscard]] bool isPure() const override;
+	void setWritten() override;
+	// Applies the chain of subscripts to obj, given the indices of all of them. The
+	// result is like the one of eval(), it may be stored in tmp
+	Object* subscript(Object* obj, Args indices,
+	                  Object& tmp) const;
 private:
+	struct Subscript
+	{
+		size_t nIndices = 0;
+		size_t pos = 0;
+	};
+
 	OperatorType opType = OperatorType::UNKNOWN;
 	// I.e. in the expression foo(a, b), foo is the main operand and a, b go
 	// in nOperands
 	ASTNode* mainOperand = nullptr;
 	std::vector<ASTNode*> nOperands{};
+	/* A subscript of a subscript, i.e. A[i][j], is joined with it into a single node,
+	 * which applies both at once like A[i, j]. The operands are the indices of all the
+	 * subscripts, which are held here in order. */
+	std::vector<Subscript> chain{};
+
+	friend class Fuser; // Takes the call and subscript trees apart
 };
 
 class BinaryNode final : public ASTNode // For binary operators
@@ -184,11 +368,54 @@ public:
 	BinaryNode();
 	~BinaryNode() override;
 	BinaryNode(ASTNode*, ASTNode*, OperatorType, size_t);
-	Object* eval(Scope*, bool lSide = false) override;
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	Object* call(Scope*, Object& calleeTmp, Args args) override;
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void compileCall(Compiler&, int base, uint32_t nArgs, size_t callPos) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+	ASTNode* fold(Optimizer&) override;
+	ExprClosure close(ClosureCompiler&, bool lSide = false) override;
+	CallClosure closeCall(ClosureCompiler&) override;
+	ASTNode* fuse(Fuser&) override;
+	void addEffects(Effects&) const override;
+	void hoistOperands(LoopOptimizer&) override;
+	[[nodiscard]] bool isMethod() const override;
+	[[nodiscard]] bool isPure() const override;
+	[[nodiscard]] bool isPureMethod() const override;
+	// The method of the receiver's type named by right (member access only)
+	[[nodiscard]] Method resolveMethod(Object& receiver) const;
 private:
+	/* Quickening: the node counts the executions in a row where both operands had the
+	 * same numerical type. After a few of them it switches to a handler specialized for
+	 * that type and operator. The handler checks the types first (the guard), and if they
+	 * differ it computes the result generically and switches back. */
+	using Handler = Object* (BinaryNode::*)(Scope*, Object&, bool);
+	// Number of executions with the same types before the node is quickened
+	static constexpr unsigned char QUICKEN_AFTER = 8;
+	// After this many failed guards the node stays generic
+	static constexpr unsigned char MAX_DEOPTS = 4;
+	Object* evalGeneric(Scope*, Object& tmp, bool lSide);
+	template <typename T, OperatorType op>
+	Object* evalQuick(Scope*, Object& tmp, bool lSide);
+	// Applies the operator (other than member access) to the evaluated operands
+	Object* apply(Object* oLeft, Object* oRight, Object& rightTmp, Object& tmp);
+	void observe(size_t leftType, size_t rightType); // Types of the operands
+	template <typename T>
+	void quicken();
+
 	OperatorType opType = OperatorType::UNKNOWN;
 	ASTNode* left = nullptr; // left operator
 	ASTNode* right = nullptr; // right operator
+	Handler handler = &BinaryNode::evalGeneric;
+	size_t lastType = 0; // Type of the operands in the last executions
+	unsigned char hits = 0; // Executions with the same types in a row
+	unsigned char deopts = 0; // Times the guard failed
+	const IDNode* methodID = nullptr; // The method name, in member access
+	// Inline cache of method calls: the method found for the last receiver's type
+	size_t cachedType = std::variant_npos;
+	Method cachedMethod = nullptr;
+
+	friend class Fuser;
 };
 
 
@@ -198,15 +425,19 @@ public:
 	LiteralNode();
 	~LiteralNode() override;
 
-	explicit LiteralNode(auto val, const size_t position) : literal(
-		new Object(val)) // Constructor can accept any type
-	{
-		pos = position;
-	}
+	// The value is interned in the constant pool of the program (see constants.h)
+	LiteralNode(const Object* value, size_t position);
 
-	Object* eval(Scope*, bool lSide = false) override;
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+	ASTNode* fold(Optimizer&) override;
+	ExprClosure close(ClosureCompiler&, bool lSide = false) override;
+	[[nodiscard]] bool isPure() const override;
+	void addEffects(Effects&) const override;
+	[[nodiscard]] const Object& getValue() const;
 private:
-	Object* literal = nullptr; // This object is set during the parsing
+	const Object* literal = nullptr; // Shared with the literals of the same value
 };
 
 class IDNode final : public ASTNode // For identifiers
@@ -215,9 +446,18 @@ public:
 	IDNode();
 	~IDNode() override;
 	IDNode(std::string, size_t);
-	Object* eval(Scope*, bool lSide = false) override;
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+	ASTNode* fold(Optimizer&) override;
+	ExprClosure close(ClosureCompiler&, bool lSide = false) override;
+	[[nodiscard]] bool isPure() const override;
+	void addEffects(Effects&) const override;
+	[[nodiscard]] const std::string& getID() const;
+	[[nodiscard]] const Binding& getBinding() const;
 private:
 	std::string id;
+	Binding binding; // Unresolved IDs (i.e. method names) are looked up by name
 };
 
 class UnaryNode final : public ASTNode // For unary operators
@@ -226,8 +466,148 @@ public:
 	UnaryNode();
 	~UnaryNode() override;
 	UnaryNode(ASTNode*, OperatorType, size_t);
-	Object* eval(Scope*, bool lSide = false) override;
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+	ASTNode* fold(Optimizer&) override;
+	ExprClosure close(ClosureCompiler&, bool lSide = false) override;
+	ASTNode* fuse(Fuser&) override;
+	void addEffects(Effects&) const override;
+	void hoistOperands(LoopOptimizer&) override;
+	[[nodiscard]] bool isPure() const override;
 private:
 	OperatorType opType = OperatorType::UNKNOWN;
 	ASTNode* operand = nullptr;
+
+	friend class Fuser;
+};
+
+/* An expression hoisted out of a loop by the loop optimizer, whose value can't change
+ * while the loop runs (i.e. A.size() - 1). It is evaluated where it is, the first time
+ * it is reached, and its value is used again until the loop ends. Like that, it gives
+ * the same errors at the same time as the expression. */
+class HoistedNode final : public ASTNode
+{
+public:
+	HoistedNode();
+	~HoistedNode() override;
+	explicit HoistedNode(ASTNode* expr);
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+	ASTNode* fuse(Fuser&) override;
+	void addEffects(Effects&) const override;
+	[[nodiscard]] bool isPure() const override;
+	void reset(); // Forgets the value, when the loop starts and ends
+
+	// Resets the nodes hoisted out of a loop while it runs
+	class LoopGuard
+	{
+	public:
+		explicit LoopGuard(const std::vector<HoistedNode*>& hoisted);
+		~LoopGuard();
+		LoopGuard(const LoopGuard&) = delete;
+		LoopGuard& operator=(const LoopGuard&) = delete;
+	private:
+		const std::vector<HoistedNode*>& hoisted;
+	};
+private:
+	ASTNode* expr = nullptr;
+	Object value{};
+	bool evaluated = false;
+};
+
+
+/* Fused nodes (see fuser.h). Each one does the work of a small tree of nodes in a single
+ * eval(), and the tree it replaces (original) is kept: the node falls back to it when
+ * the operands don't have the expected types, and it is what gets resolved and compiled
+ * to bytecode. Errors get the same positions as in the original tree. */
+class FusedNode : public ASTNode
+{
+public:
+	FusedNode();
+	~FusedNode() override;
+	explicit FusedNode(ASTNode* original);
+	void compile(Compiler&, int dst, bool lSide = false) const override;
+	void resolve(Resolver&, bool lSide = false) override;
+protected:
+	ASTNode* original = nullptr;
+};
+
+class IncrementNode final : public FusedNode // i = i + 1, i += 1, i++, --i etc.
+{
+public:
+	IncrementNode();
+	~IncrementNode() override;
+	// The variable, the amount added to it, whether the result is the old value (i++)
+	// and whether the variable may be created (i = i + 1)
+	IncrementNode(ASTNode* original, ASTNode* target, int delta, bool isPostfix,
+	              bool isAssignment);
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+private:
+	ASTNode* target = nullptr;
+	int delta = 0;
+	bool isPostfix = false;
+	bool isAssignment = false;
+};
+
+class StoreNode final : public FusedNode // A[i] = x, where x has no side effects
+{
+public:
+	StoreNode();
+	~StoreNode() override;
+	// The subscript assigned to, its variable and indices, and the value
+	StoreNode(ASTNode* original, const nAryNode* subscript, ASTNode* array,
+	          std::vector<ASTNode*> indices, ASTNode* value, size_t position);
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+private:
+	const nAryNode* subscript = nullptr;
+	ASTNode* array = nullptr;
+	std::vector<ASTNode*> indices{};
+	ASTNode* value = nullptr;
+};
+
+// A binary operator whose operands are variables, literals or hoisted expressions, i.e.
+// x < N. The operands are used where they are, without copying them to temporaries
+class LeafBinaryNode final : public FusedNode
+{
+public:
+	LeafBinaryNode();
+	~LeafBinaryNode() override;
+	LeafBinaryNode(ASTNode* original, ASTNode* left, ASTNode* right, OperatorType,
+	               size_t position);
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	[[nodiscard]] bool isPure() const override;
+private:
+	// The operand, which is a variable, a hoisted expression or a literal's value
+	Object* operand(ASTNode* node, Object* value, Scope*, Object& tmp, bool lSide) const;
+
+	BinaryOperator op = nullptr;
+	ASTNode* left = nullptr;
+	ASTNode* right = nullptr;
+	Object* leftValue = nullptr; // The values of the literal operands
+	Object* rightValue = nullptr;
+};
+
+// A call of a method of a variable, i.e. S.push(x). With negated, the result is
+// negated, i.e. not S.isEmpty()
+class MethodCallNode final : public FusedNode
+{
+public:
+	MethodCallNode();
+	~MethodCallNode() override;
+	// The member access, its receiver, the arguments and the position of the call
+	MethodCallNode(ASTNode* original, const BinaryNode* member, ASTNode* receiver,
+	               std::vector<ASTNode*> args, bool negated, size_t position);
+	Object* eval(Scope*, Object& tmp, bool lSide = false) override;
+	[[nodiscard]] bool isCall() const override;
+private:
+	const BinaryNode* member = nullptr;
+	ASTNode* receiver = nullptr;
+	std::vector<ASTNode*> args{};
+	bool negated = false;
+	size_t cachedType = std::variant_npos; // Inline cache, like in BinaryNode
+	Method cachedMethod = nullptr;
+
+	friend class Fuser; // Negates it
 };
@@ -0,0 +1,47 @@
+/* arena.h */
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* A bump allocator. Objects are placed one after the other in large chunks, and are all
+ * destroyed together with the arena, in reverse order of creation. Used for the nodes of
+ * the AST, which live as long as the program. */
+class Arena
+{
+public:
+	Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	Arena(Arena&&) noexcept;
+	Arena& operator=(Arena&&) noexcept;
+	~Arena();
+
+	template <typename T, typename... Args>
+	T* make(Args&&... args) // Constructs an object in the arena
+	{
+		T* obj = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			dtors.push_back({obj, [](void* ptr) { static_cast<T*>(ptr)->~T(); }});
+		return obj;
+	}
+private:
+	void* allocate(size_t size, size_t align);
+	void release(); // Destroys all the objects and frees the chunks
+
+	struct Destructor
+	{
+		void* obj;
+		void (*destroy)(void*);
+	};
+
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+	std::vector<std::unique_ptr<std::byte[]>> chunks{};
+	std::byte* curr = nullptr; // Next free byte of the last chunk
+	std::byte* end = nullptr;
+	std::vector<Destructor> dtors{};
+};
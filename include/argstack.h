@@ -0,0 +1,50 @@
+/* argstack.h */
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "object.h"
+
+/* The arguments of the calls and subscripts being evaluated by the tree-walker. A call
+ * takes a frame of consecutive entries, each one a pointer to an argument and an object
+ * to hold it if it's a temporary. The arguments are passed as a view of the pointers
+ * (see Args), so no vector is allocated per call.
+ * Frames are taken and freed in LIFO order. The entries are kept in chunks that never
+ * move, so the arguments of a call stay in place while the ones of the calls nested in
+ * it are evaluated. The stack is thread local, like the object pool. */
+class ArgStack
+{
+public:
+	class Frame
+	{ // The entries of a call. They are freed, and the temporaries reset, on exit
+	public:
+		explicit Frame(size_t n);
+		Frame(const Frame&) = delete;
+		Frame& operator=(const Frame&) = delete;
+		~Frame();
+
+		[[nodiscard]] Object*& arg(size_t i) const { return args[i]; }
+		[[nodiscard]] Object& tmp(size_t i) const { return tmps[i]; }
+		[[nodiscard]] Args getArgs() const { return {args, n}; }
+	private:
+		size_t chunk = 0; // Position of the frame, restored on exit
+		size_t start = 0;
+		size_t n = 0;
+		Object** args = nullptr;
+		Object* tmps = nullptr;
+	};
+private:
+	struct Chunk
+	{
+		explicit Chunk(size_t capacity);
+		std::unique_ptr<Object*[]> args;
+		std::unique_ptr<Object[]> tmps;
+		size_t capacity = 0;
+		size_t used = 0;
+	};
+
+	static constexpr size_t CHUNK_SIZE = 256; // Entries, bigger frames get their own
+	static thread_local std::vector<Chunk> chunks;
+	static thread_local size_t curr; // The chunk of the frame on top
+};
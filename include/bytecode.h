@@ -0,0 +1,156 @@
+/* bytecode.h */
+
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "object.h"
+
+class CodeBlock;
+class ASTNode;
+class IDNode;
+class nAryNode;
+
+/* The bytecode is register based. Every compiled unit (the main program or a method
+ * body) gets a window of registers. A register either refers to an existing object
+ * (i.e. a variable or an array element, so that it can be assigned to) or holds a
+ * temporary value of its own, so no temporary objects are allocated on the heap.
+ * In the comments below, R[x] is register x, K[x] is constant x, I[x] is identifier x
+ * (with its resolved binding), N[x] is name x, M[x] is method call site x and S[x]
+ * is subscript chain x. */
+enum class OpCode : uint8_t
+{
+	LOAD_CONST, // R[a] = K[b]
+	LOAD_NAME, // R[a] = variable I[b]
+	DEF_NAME, // R[a] = variable I[b], created if it does not exist
+	COPY, // R[a] = copy of R[b] (an rvalue)
+	MOVE, // R[a] = R[b], R[b] is left unspecified
+	SELECT, // R[a] = R[b] if it is an lvalue, else a copy of it (comma operator)
+	NOT_VOID, // Fatal error if R[a] holds nothing (i.e. the result of push())
+	// Binary operators: R[a] = R[b] op R[c]
+	ADD,
+	SUB,
+	MUL,
+	DIV,
+	MOD,
+	INT_DIV,
+	LESS,
+	LESS_EQ,
+	GREATER,
+	GRE_EQ,
+	EQUAL,
+	NOT_EQUAL,
+	OR,
+	AND,
+	// Assignments: R[b] op= R[c], then R[a] = R[b] which must be an lvalue
+	ASSIGN,
+	ADD_ASSIGN,
+	SUB_ASSIGN,
+	MUL_ASSIGN,
+	DIV_ASSIGN,
+	MOD_ASSIGN,
+	INT_DIV_ASSIGN,
+	// Unary operators: R[a] = op R[b]
+	NOT,
+	NEGATE,
+	PLUS,
+	PRE_INCR,
+	PRE_DECR,
+	POST_INCR,
+	POST_DECR,
+	GET_METHOD, // R[a] = method N[b] of R[a]. c is the position of the method name
+	CALL, // R[a] = R[a](R[a + 1], ..., R[a + c])
+	CALL_METHOD, // R[a] = method M[b] of R[a] called with R[a + 1], ..., R[a + c]
+	SUBSCRIPT, // R[a] = R[a][R[a + 1], ..., R[a + c]], to be changed if b is set
+	SUBSCRIPT_CHAIN, // Like SUBSCRIPT, for the chain of subscripts S[b] (i.e. A[i][j])
+	LIST, // R[a] = [R[a + 1], ..., R[a + c]]
+	JUMP, // Go to instruction c
+	JUMP_IF_FALSE, // Go to instruction c if R[a] is not true
+	ENTER_BLOCK, // Increase the scope level, with a frame of b slots
+	EXIT_BLOCK, // Decrease the scope level
+	FOR_CHECK, // Value error at position c if R[a] > R[b]
+	SET, // R[a] = R[b] without an lvalue check (for counters and methods)
+	INCR, // ++R[a] without an lvalue check
+	FOR_LOOP, // ++R[a], then go to instruction c if R[a] <= R[b] (counted loops)
+	FUNCTION, // R[a] = method compiled in unit b
+	RETURN, // Return a copy of R[a]
+	RETURN_ERROR, // Return statement outside of a method
+	RELEASE_LOCKS, // Ends a statement that may have locked containers (see WriteLocks)
+	HALT // End of the unit
+};
+
+struct Instruction
+{
+	OpCode op = OpCode::HALT;
+	uint16_t a = 0; // Usually the destination register
+	uint16_t b = 0;
+	uint32_t c = 0; // Also holds jump targets and positions in the source
+};
+
+// Instructions that must not set the position of an error (like the statements of the
+// tree-walker, which let errors propagate to the enclosing operator)
+constexpr size_t NO_POS = std::numeric_limits<size_t>::max();
+
+struct MethodCall
+{ // A call site of a method, i.e. S.push(1)
+	std::string name;
+	size_t pos = 0; // Position of the member access operator
+	size_t namePos = 0; // Position of the method name
+	// Inline cache: the method found for the last receiver's type
+	mutable size_t cachedType = std::variant_npos;
+	mutable Method cachedMethod = nullptr;
+};
+
+struct Proto
+{ // A compiled unit: the main program or the body of a method
+	std::string name;
+	std::vector<Instruction> code;
+	std::vector<size_t> positions; // Source position of each instruction
+	std::vector<Object> constants;
+	std::vector<const IDNode*> ids; // Identifiers of variables
+	std::vector<std::string> names; // Method names
+	std::vector<MethodCall> methodCalls;
+	std::vector<const nAryNode*> subscripts; // Chains of subscripts
+	std::vector<std::unique_ptr<Proto>> protos; // Methods defined in this unit
+	CodeBlock* block = nullptr; // The method's AST, used to create Function objects
+	std::vector<ASTNode*> params{};
+	int nRegs = 0; // Size of the register window
+};
+
+class Compiler
+{
+public:
+	Compiler();
+	std::unique_ptr<Proto> compile(const CodeBlock*); // Compiles the main block
+	// Compiles a method body into a new unit of the current one, returns its index
+	uint16_t compileMethod(const std::string& name, CodeBlock*,
+	                       const std::vector<ASTNode*>& params);
+
+	// Used by the nodes to emit their code
+	size_t emit(OpCode, int a = 0, uint32_t b = 0, uint32_t c = 0,
+	            size_t pos = NO_POS);
+	void patch(size_t at, size_t target); // Sets the jump target of an instruction
+	[[nodiscard]] size_t here() const; // Index of the next instruction
+	uint16_t addConstant(const Object&);
+	uint16_t addID(const IDNode*);
+	uint16_t addSubscript(const nAryNode*);
+	uint16_t addName(const std::string&);
+	uint16_t addMethodCall(const std::string& name, size_t pos, size_t namePos);
+	// Reserves n consecutive registers, for the node at pos (used by errors)
+	int reserve(int n, size_t pos);
+	void release(int reg); // Frees reg and all registers above it
+	// Around the code of a statement, which releases the locks it may take
+	void beginStatement();
+	void endStatement();
+	[[nodiscard]] int getFreeReg() const;
+	[[nodiscard]] bool isInFunction() const;
+private:
+	Proto* proto = nullptr; // The unit being compiled
+	int freeReg = 0; // First unused register
+	bool inFunction = false;
+	bool locksTaken = false; // By the current statement
+};
+
+std::string disassemble(const Proto&); // Human readable listing of a unit
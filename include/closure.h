@@ -0,0 +1,34 @@
+/* closure.h */
+
+#pragma once
+#include <deque>
+#include <functional>
+#include "object.h"
+
+class CodeBlock;
+class Scope;
+
+/* The closure compiler (-c) turns the AST, once before execution, into a tree of
+ * closures that call each other directly. Each closure is made for its node: the
+ * operator, whether a variable is assigned to, the slots of an identifier and the
+ * kind of statement are fixed when it is made, so running it doesn't switch on the
+ * operator or go through the virtual eval() of the nodes. The closures apply the same
+ * operators as the tree-walker (see binaryOperator() in AST.h), and their errors get
+ * the same positions. */
+
+// An expression. The result is like the one of ASTNode::eval(), it may be stored in tmp
+using ExprClosure = std::function<Object*(Scope*, Object& tmp)>;
+// A call of the value of an expression, like ASTNode::call()
+using CallClosure = std::function<Object*(Scope*, Object& calleeTmp, Args)>;
+
+class ClosureCompiler
+{
+public:
+	ClosureCompiler();
+	StmtClosure compile(CodeBlock* mainBlock);
+	// Used by the nodes. The body of a function lives as long as the compiler, as the
+	// functions defined by it refer to it
+	const StmtClosure* addBody(StmtClosure);
+private:
+	std::deque<StmtClosure> bodies{}; // A deque, so the bodies stay in place
+};
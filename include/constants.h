@@ -0,0 +1,32 @@
+/* constants.h */
+
+#pragma once
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include "object.h"
+
+/* The values of the literals of a program. Each value is stored once, and literals
+ * with the same value (i.e. every "" in the program) refer to the same object. A literal
+ * evaluates to a copy of its value, which shares the value's container until it is
+ * changed (see Ref), so evaluating a string or list literal doesn't allocate.
+ * The values are never changed, and live as long as the program. */
+class ConstantPool
+{
+public:
+	ConstantPool();
+	ConstantPool(const ConstantPool&) = delete;
+	ConstantPool& operator=(const ConstantPool&) = delete;
+	ConstantPool(ConstantPool&&) noexcept;
+	ConstantPool& operator=(ConstantPool&&) noexcept;
+	~ConstantPool();
+
+	const Object* intern(const Object&); // The pooled object with that value
+private:
+	// A deque, so the values stay in place while others are added
+	std::deque<Object> values{};
+	// The values that can be looked up: numbers, bools, chars and strings. The key
+	// is the type and the bytes of the value.
+	std::map<std::pair<size_t, std::string>, const Object*> index{};
+};
@@ -0,0 +1,30 @@
+/* effects.h */
+
+#pragma once
+#include <set>
+#include <string>
+#include "scope.h"
+
+class ASTNode;
+
+/* The effects of a part of the program, found before it runs: the names of the variables
+ * it reads and may assign to (an element of A, or a method like A.push(), assigns to A),
+ * and whether it calls a function, which may assign to any variable it can reach. The
+ * hardcoded functions and the methods only assign to their arguments and receivers. */
+class Effects
+{
+public:
+	explicit Effects(const Scope& globalScope); // The scope with the hardcoded objects
+	// Used by the nodes
+	void addRead(const std::string& id);
+	void addWrite(const std::string& id);
+	void addCall(const ASTNode* callee);
+	// Whether running the part may change the value of an expression with the given
+	// effects (which has no side effects itself)
+	[[nodiscard]] bool mayChange(const Effects& expr) const;
+private:
+	const Scope& globalScope;
+	std::set<std::string> reads{};
+	std::set<std::string> writes{};
+	bool callsFunction = false;
+};
@@ -0,0 +1,37 @@
+/* fuser.h */
+
+#pragma once
+#include "arena.h"
+
+class ASTNode;
+class CodeBlock;
+class nAryNode;
+class BinaryNode;
+class UnaryNode;
+class MethodCallNode;
+
+/* The fuser runs over the AST after the optimizer, before the resolver. It replaces the
+ * small trees that are most common in pseudocode with fused nodes (see AST.h), which do
+ * the work of the whole tree in a single eval(), using the operands where they are:
+ * - i = i + 1, i -= 2, i++ and --i, of a variable (IncrementNode)
+ * - A[i] = x and A[i][j] = x, where x has no side effects (StoreNode)
+ * - x < N, i + 1 etc., of variables, literals and hoisted expressions (LeafBinaryNode)
+ * - S.push(x) and not S.isEmpty(), of a variable (MethodCallNode) */
+class Fuser
+{
+public:
+	explicit Fuser(Arena& arena); // The arena of the program, where the nodes are put
+	void fuse(CodeBlock* mainBlock);
+
+	// Used by the nodes, they return the node that replaces the given one
+	ASTNode* fuseCall(nAryNode*);
+	ASTNode* fuseBinary(BinaryNode*);
+	ASTNode* fuseUnary(UnaryNode*);
+private:
+	ASTNode* fuseIncrement(BinaryNode*); // i = i + 1 and i += 1, nullptr if it isn't one
+	ASTNode* fuseStore(BinaryNode*); // nullptr if it isn't an assignment to an element
+	// The call of a method of a variable, nullptr if it isn't one
+	MethodCallNode* fuseMethodCall(nAryNode*, ASTNode* original, bool negated);
+
+	Arena& arena;
+};
@@ -0,0 +1,45 @@
+/* loops.h */
+
+#pragma once
+#include "arena.h"
+#include "effects.h"
+#include "scope.h"
+#include <vector>
+
+class ASTNode;
+class CodeBlock;
+class HoistedNode;
+
+/* The loop optimizer runs over the AST after the optimizer, before the fuser.
+ * - It finds the for loops whose limits can't change while they run: the limits have no
+ *   side effects, and neither the counter nor the body assign to the variables they read
+ *   or call a function. These counted loops evaluate their limits once, and compare and
+ *   increment an int counter directly in its slot (see countedLoop() in AST.h).
+ * - It hoists the expressions of a loop (in its condition, limits or body) whose values
+ *   can't change while it runs, for the same reasons, i.e. A.size() - 1 in
+ *   loop while i < A.size() - 1. They are evaluated once per run of the loop (see
+ *   HoistedNode in AST.h). Each one goes to the outermost loop it is invariant in, and
+ *   only the largest invariant expressions are hoisted. */
+class LoopOptimizer
+{
+public:
+	// The scope with the hardcoded objects, and the arena of the program
+	LoopOptimizer(const Scope& globalScope, Arena& arena);
+	void optimize(CodeBlock* mainBlock);
+
+	// Used by the nodes
+	[[nodiscard]] Effects makeEffects() const;
+	// Whether the value of expr can't change while code with the given effects runs
+	[[nodiscard]] bool isInvariant(const ASTNode* expr, const Effects& loop) const;
+	// The expressions hoisted between these go to the loop with the given effects
+	void beginLoop(const Effects& loop, std::vector<HoistedNode*>& hoisted);
+	void endLoop();
+	// Returns the node that replaces expr: a hoisted node if it is invariant, or expr
+	// with its invariant operands hoisted
+	ASTNode* hoist(ASTNode* expr);
+private:
+	const Scope& globalScope;
+	Arena& arena;
+	const Effects* loop = nullptr; // The loop being hoisted from
+	std::vector<HoistedNode*>* hoisted = nullptr;
+};
@@ -6,9 +6,9 @@
 #include <memory>
 #include <functional>
 #include <variant>
-#include <stack>
-#include <queue>
-#include "AST.h"
+#include <string_view>
+#include <span>
+#include "pool.h"
 #include "scope.h"
 
 class CollectionContainer;
@@ -19,14 +19,156 @@ class Scope;
 class ArrayContainer;
 class StackContainer;
 class StringContainer;
-using ExternalFunction = std::function<Object*(const std::vector<Object*>&)>;
-// Tagged union used to hold all possible types of object
+struct Proto;
+// The arguments of a call (or the indices of a subscript). They are given as a view
+// of the caller's arguments (see ArgStack), so passing them doesn't allocate
+using Args = std::span<Object* const>;
+using ExternalFunction = std::function<Object*(Args)>;
+// A statement (or block) turned into a closure, see closure.h
+using StmtClosure = std::function<Object*(Scope*, bool isInFunction)>;
+// A method of a container type. The receiver is the object holding the container
+using Method = Object* (*)(Object& receiver, Args args);
+struct MethodEntry
+{
+	std::string name;
+	Method method = nullptr;
+	bool modifies = false; // Whether it changes the container, i.e. push()
+};
+using MethodTable = std::vector<MethodEntry>;
+// The containers whose elements are stored unboxed, and changed through proxies (see
+// Object::storeBack)
+using PackedContainer = std::variant<ArrayContainer*, StringContainer*>;
+
+template <typename T>
+class Ref
+{ /* Reference counted pointer used for automatic memory deallocation at deletion.
+   * Unlike std::shared_ptr, the count is stored next to the value, so a Ref is a
+   * single pointer.
+   * Containers are shared by the objects they are copied to, and copied when one of
+   * the objects changes them (copy on write, see Object::unshare). A pinned value is
+   * never shared this way, as something refers to it directly (i.e. a method value),
+   * and neither is a locked one while it is being changed (see WriteLocks). */
+public:
+	Ref() = default;
+	Ref(const Ref& ref2) : box(ref2.box) { if (box) box->refCount++; }
+	Ref(Ref&& ref2) noexcept : box(ref2.box) { ref2.box = nullptr; }
+	~Ref() { if (box && --box->refCount == 0) delete box; }
+
+	Ref& operator=(Ref ref2) noexcept
+	{
+		std::swap(box, ref2.box);
+		return *this;
+	}
+
+	template <typename... Args>
+	static Ref make(Args&&... args)
+	{
+		Ref ref;
+		ref.box = new Box(std::forward<Args>(args)...);
+		return ref;
+	}
+
+	T* operator->() const { return &box->value; }
+	T& operator*() const { return box->value; }
+	[[nodiscard]] T* get() const { return (box) ? (&box->value) : (nullptr); }
+	[[nodiscard]] bool isShared() const
+	{ // The references held by the locks don't count
+		return box->refCount - box->locks > 1 && !box->pinned;
+	}
+	[[nodiscard]] bool isPinned() const { return box->pinned; }
+	void pin() const { box->pinned = true; }
+	[[nodiscard]] bool isLocked() const { return box->locks != 0; }
+	// Locks the value, which is kept alive until unlock() is given the result
+	[[nodiscard]] void* lock() const
+	{
+		box->refCount++;
+		box->locks++;
+		return box;
+	}
+	static void unlock(void* locked)
+	{
+		Box* lockedBox = static_cast<Box*>(locked);
+		lockedBox->locks--;
+		if (--lockedBox->refCount == 0) delete lockedBox;
+	}
+private:
+	struct Box
+	{
+		template <typename... Args>
+		explicit Box(Args&&... args) : value(std::forward<Args>(args)...)
+		{
+		}
+
+		// Boxes are allocated in the pool, like objects
+		static void* operator new(const size_t size) { return Pool::allocate(size); }
+		static void operator delete(void* ptr, const size_t size)
+		{
+			Pool::deallocate(ptr, size);
+		}
+
+		int refCount = 1;
+		int locks = 0;
+		bool pinned = false;
+		T value;
+	};
+
+	Box* box = nullptr;
+};
+
+template <typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) { return Ref<T>::make(std::forward<Args>(args)...); }
+
+/* The containers being changed by the current statements. The element assigned to is
+ * found before the value is evaluated, which may copy the container meanwhile (i.e.
+ * C = B in a function called by B[0] = f()), or be the container itself (A[0] = A).
+ * A locked container is copied right away instead of shared, so that the copies don't
+ * see the change. A statement releases the locks it took when it ends. */
+class WriteLocks
+{
+public:
+	template <typename T>
+	static void lock(const Ref<T>& container)
+	{
+		locks.push_back({container.lock(), &Ref<T>::unlock});
+	}
+
+	[[nodiscard]] static size_t mark() { return locks.size(); } // Locks taken so far
+	static void release(const size_t mark) // Releases the locks taken after mark
+	{
+		if (locks.size() > mark) unlockAfter(mark);
+	}
+private:
+	struct Lock
+	{
+		void* box = nullptr;
+		void (*unlock)(void*) = nullptr;
+	};
+
+	static void unlockAfter(size_t mark);
+	static std::vector<Lock> locks;
+};
+
+// Tagged union used to hold all possible types of object. Numbers, booleans and chars
+// are stored inline, everything else behind a single pointer.
 using VariantType = std::variant<
-	int, std::shared_ptr<StringContainer>, bool, float, char,
-	std::shared_ptr<ArrayContainer>, std::shared_ptr<StackContainer>,
-	std::shared_ptr<QueueContainer>, std::shared_ptr<CollectionContainer>,
-	Function, ExternalFunction>;
-// Shared ptr used for automatic memory deallocation at deletion
+	int, Ref<StringContainer>, bool, float, char, Ref<ArrayContainer>,
+	Ref<StackContainer>, Ref<QueueContainer>, Ref<CollectionContainer>,
+	Ref<Function>, Ref<ExternalFunction>>;
+static_assert(sizeof(VariantType) == 16, "Values must fit in 16 bytes.");
+
+template <typename T, typename Variant>
+struct isAlternative;
+
+template <typename T, typename... Ts>
+struct isAlternative<T, std::variant<Ts...>>
+	: std::bool_constant<(std::is_same_v<T, Ts> || ...)>
+{
+};
+
+// The types an Object can be initialized with directly
+template <typename T>
+concept ValueType = std::is_same_v<T, VariantType> ||
+	isAlternative<T, VariantType>::value;
 
 class ASTNode;
 class CodeBlock;
@@ -38,84 +180,123 @@ public:
 	// pointing to objects. Smart vectors ensure memory dealocation for the
 	// complex recursive std::variant type
 	using ArrayType = std::vector<std::unique_ptr<Object>>;
+	/* Arrays that hold only ints, floats, bools or chars are packed: the values are
+	 * stored unboxed, one after the other. An array is unpacked to an ArrayType when a
+	 * value of another type is stored in it.
+	 * A packed multi-dimensional array (i.e. Array(3, 4), or [[1, 2], [3, 4]]) is stored
+	 * in a single row-major buffer with its shape, so A[i, j] is found with a single
+	 * offset. It is split into an ArrayType of its sub-arrays when one of them is
+	 * changed as a whole (i.e. A[i] = B), or when a value of another type is stored. */
+	using Storage = std::variant<ArrayType, std::vector<int>, std::vector<float>,
+	                             std::vector<bool>, std::vector<char>>;
 	ArrayContainer();
 	// Different assignment & copy contructors
 	ArrayContainer(const ArrayContainer&);
 	ArrayContainer& operator=(const ArrayContainer&);
-	explicit ArrayContainer(const std::vector<Object*>&);
+	explicit ArrayContainer(Args);
 	ArrayContainer(const std::vector<size_t>&);
-	// Get the object in a specific index
-	[[nodiscard]] Object* getArray(const std::vector<Object*>&) const;
-	[[nodiscard]] Object* size(const std::vector<Object*>&) const; // Get # of elements
+	// The sub-array of a multi-dimensional array at offset, among the ones after
+	// nIndices indices (i.e. i in A[i] for nIndices = 1)
+	ArrayContainer(const ArrayContainer&, size_t nIndices, size_t offset);
+	// Get the object in a specific index. An element of a packed array is copied to tmp
+	[[nodiscard]] Object* getArray(Args, Object& tmp) const;
+	// Like getArray(), for an element that is about to be changed. The arrays the
+	// element is in are unshared (see Object::unshare), and an element of a packed array
+	// is given as a proxy (see Object::storeBack)
+	[[nodiscard]] Object* getWritable(Args);
+	void store(size_t index, const Object&); // Unpacks the array if needed
+	// The index of the element of a packed array at the indices (one per dimension), to
+	// store a value there without a proxy. npos if the indices aren't all valid or the
+	// array isn't packed, then getWritable() gives the element (or the error)
+	[[nodiscard]] size_t getOffset(Args) const;
+	static constexpr size_t npos = static_cast<size_t>(-1);
+	[[nodiscard]] Object* size(Args) const; // Get # of elements
 	void copyArrays(ArrayType& a1, const ArrayType& a2) const;
-	Scope& getMethodScope(); // Get a scope with all the hardcoded methods of
-	// the array. 
+	// The hardcoded methods. They are shared by all the arrays, the array is passed
+	// as the receiver.
+	static const MethodTable& getMethods();
 private:
-	void addMethods(); // Adds hardcoded methods to methodScope
-	ArrayType array;
-	Scope methodScope;
+	// Checks the indices and gives the offset they refer to in array
+	[[nodiscard]] size_t checkIndex(Args) const;
+	[[nodiscard]] std::vector<size_t> getShape() const; // The shape of 1D arrays too
+	template <typename T>
+	bool pack(Args); // If all the objects hold a T
+	bool packArrays(Args); // If all are packed alike
+	void unpack();
+	void split(); // Splits a multi-dimensional array into its sub-arrays
+
+	Storage array;
+	std::vector<size_t> shape; // The dimensions of a multi-dimensional array
 };
 
 class StringContainer
 { // Similar to ArrayContainer, but only 1D and can contain only char types
 public:
-	using StringType = std::vector<std::unique_ptr<Object>>; // Like ArrayContainer
+	/* The chars are always packed. The string is the start of a buffer, which it shares
+	 * with its copies. Appending to a string that reaches the end of the buffer appends
+	 * to the buffer itself, so building a string with + takes amortized O(1) per append.
+	 * A change to a shared buffer copies it first. */
+	using StringType = Ref<std::string>;
 	StringContainer();
-	StringContainer(const StringContainer&);
-	StringContainer& operator=(const StringContainer&);
-	explicit StringContainer(const std::vector<Object*>&);
-	explicit StringContainer(const std::string&);
-	[[nodiscard]] Object* getChar(const std::vector<Object*>&);
-	[[nodiscard]] std::string getStr() const;
-	Object* length(const std::vector<Object*>&);
-	void copyStrings(StringType&, const StringType&) const;
-	Scope& getMethodScope();
+	explicit StringContainer(Args);
+	explicit StringContainer(std::string);
+	// Like in ArrayContainer, the char is copied to tmp, or given as a proxy to change it
+	[[nodiscard]] Object* getChar(Args, Object& tmp) const;
+	[[nodiscard]] Object* getWritable(Args);
+	void store(size_t index, const Object&);
+	void append(std::string_view);
+	[[nodiscard]] std::string_view getStr() const;
+	[[nodiscard]] Object* length(Args) const;
+	static const MethodTable& getMethods();
 private:
-	void addMethods();
-	Scope methodScope;
+	[[nodiscard]] size_t checkIndex(Args) const;
+
 	StringType string;
+	size_t size = 0; // The string is the first size chars of the buffer
 };
 
 class StackContainer
 {
 public:
-	using StackType = std::stack<std::unique_ptr<Object>>;
-	// std::stack is the underlying implementation
+	using StackType = std::vector<std::unique_ptr<Object>>;
+	// The top of the stack is the back of the vector
 	// contructors are similar in all containers
 	StackContainer();
 	StackContainer(const StackContainer& sc2);
 	StackContainer& operator=(const StackContainer& sc2);
-	explicit StackContainer(const std::vector<Object*>&);
+	explicit StackContainer(Args);
 	// Stack's methods are push, pop and isEmpty
-	[[nodiscard]] Object* push(const std::vector<Object*>&);
-	[[nodiscard]] Object* pop(const std::vector<Object*>&);
-	[[nodiscard]] Object* isEmpty(const std::vector<Object*>& argVec) const;
+	[[nodiscard]] Object* push(Args);
+	[[nodiscard]] Object* pop(Args);
+	[[nodiscard]] Object* isEmpty(Args argVec) const;
 	void copyStacks(StackType& stack1, const StackType& stack2) const;
-	Scope& getMethodScope();
+	static const MethodTable& getMethods();
 private:
-	void addMethods();
 	StackType stack;
-	Scope methodScope;
 };
 
 class QueueContainer
 {
 public:
-	using QueueType = std::queue<std::unique_ptr<Object>>;
-	// std::queue is the underlying implementation
+	/* The queue is a ring buffer: the count elements starting at head (and wrapping
+	 * around the end) are the queue, front first. The buffer grows when it is full. */
+	using QueueType = std::vector<std::unique_ptr<Object>>;
 	QueueContainer();
 	QueueContainer(const QueueContainer&);
 	QueueContainer& operator=(const QueueContainer&);
-	explicit QueueContainer(const std::vector<Object*>&);
-	[[nodiscard]] Object* enqueue(const std::vector<Object*>&);
-	[[nodiscard]] Object* dequeue(const std::vector<Object*>&);
-	[[nodiscard]] Object* isEmpty(const std::vector<Object*>& argVec) const;
-	void copyQueues(QueueType&, const QueueType&) const;
-	Scope& getMethodScope();
+	explicit QueueContainer(Args);
+	[[nodiscard]] Object* enqueue(Args);
+	[[nodiscard]] Object* dequeue(Args);
+	[[nodiscard]] Object* isEmpty(Args argVec) const;
+	static const MethodTable& getMethods();
 private:
-	void addMethods();
+	void copyQueue(const QueueContainer&); // Copies the elements in order
+	void grow(); // Moves the elements to a larger buffer
+	static constexpr size_t QUEUE_MIN_SIZE = 8; // The size of the buffer when it first grows
+
 	QueueType queue;
-	Scope methodScope;
+	size_t head = 0; // The position of the front element
+	size_t count = 0;
 };
 
 class CollectionContainer
@@ -127,44 +308,66 @@ public:
 	CollectionContainer();
 	CollectionContainer(const CollectionContainer&);
 	CollectionContainer& operator=(const CollectionContainer&);
-	explicit CollectionContainer(const std::vector<Object*>&);
-	[[nodiscard]] Object* addItem(const std::vector<Object*>&);
-	[[nodiscard]] Object* getNext(const std::vector<Object*>&);
-	[[nodiscard]] Object* resetNext(const std::vector<Object*>& argVec);
-	[[nodiscard]] Object* hasNext(const std::vector<Object*>& argVec) const;
-	[[nodiscard]] Object* isEmpty(const std::vector<Object*>& argVec) const;
+	explicit CollectionContainer(Args);
+	[[nodiscard]] Object* addItem(Args);
+	[[nodiscard]] Object* getNext(Args);
+	[[nodiscard]] Object* resetNext(Args argVec);
+	[[nodiscard]] Object* hasNext(Args argVec) const;
+	[[nodiscard]] Object* isEmpty(Args argVec) const;
 	void copyCollections(CollectionType&, const CollectionType&) const;
-	Scope& getMethodScope();
+	static const MethodTable& getMethods();
 private:
-	void addMethods();
 	int index = -1; // Index to simulate linked list
 	CollectionType collection;
-	Scope methodScope;
 };
 
 class Function // A user defined function
 {
 public:
 	Function();
-	Function(CodeBlock*, std::vector<ASTNode*>, int);
+	Function(CodeBlock*, std::vector<ASTNode*>, int, const Proto* = nullptr,
+	         const StmtClosure* = nullptr);
 	// argVec contains the passed arguments - objects
-	Object* eval(Scope* scope, const std::vector<Object*>& argVec) const;
+	Object* eval(Scope* scope, Args argVec) const;
+	// Enters the function's frame in scope and binds the arguments to the parameters.
+	// The body can then be run by either the tree-walker or the VM, and
+	// Scope::exitFunction() must be called when it returns.
+	void bindArgs(Scope* scope, Args argVec) const;
+	[[nodiscard]] const Proto* getProto() const; // Compiled body, if any
 private:
 	CodeBlock* block = nullptr;
 	std::vector<ASTNode*> paramVec{};
 	int definedFuncLevel = 0;
+	const Proto* proto = nullptr; // Set when the function was defined by the VM
+	const StmtClosure* body = nullptr; // Set when it was defined by a closure
 };
 
+// The method of the receiver's type with that name, nullptr if there's none. Throws a
+// type error if the receiver isn't a container.
+Method findMethod(Object& receiver, const std::string& name);
+// Whether a method of some container with that name changes it
+bool isModifyingMethod(const std::string& name);
+// A method as a value (i.e. m = S.push). It holds on to the receiver's container,
+// which is pinned.
+ExternalFunction bindMethod(Object& receiver, Method method);
+
 class Object
 {
 public:
 	Object();
 	Object(const Object& obj2);
-	explicit Object(const auto& val) { data = val; } // Init. directly with value
+	template <ValueType T>
+	explicit Object(const T& val) { data = val; } // Init. directly with value
+	explicit Object(Function); // Functions are stored behind a pointer
+	explicit Object(ExternalFunction);
 	[[nodiscard]] bool isLval() const;
 	void setLval(bool isIt);
 	VariantType data; // The tagged union
 
+	// Objects are allocated in the pool (see pool.h)
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	// All operators are overloaded and defined in operators.cpp
 	Object& operator=(const Object&);
 	Object& operator+=(Object&);
@@ -194,8 +397,20 @@ public:
 	friend Object operator!=(Object&, Object&);
 	friend Object operator||(Object&, Object&);
 	friend Object operator&&(Object&, Object&);
-	Object* operator()(Scope*, const std::vector<Object*>&);
-	Object* operator[](const std::vector<Object*>&);
+	Object* operator()(Scope*, Args);
+	// The subscript operator. The element may be copied to tmp (see ArrayContainer)
+	Object* getElement(Args, Object& tmp);
+	// Like getElement(), for an element that is about to be changed
+	Object* getWritable(Args);
+	/* An element of a packed array that is about to be changed is copied to a proxy.
+	 * Once changed, the proxy is stored back to the array, which frees it. The proxies
+	 * are stored back in the reverse order they were given. */
+	[[nodiscard]] bool isProxy() const;
+	void storeBack(); // Does nothing if the object isn't a proxy
+	// Gives the object its own copy of a container shared with other objects
+	void unshare();
+	// Unshares the container before it is changed, and locks it (see WriteLocks)
+	void prepareWrite();
 	bool isTrue(); // If the object can be evaluated as true or false
 	std::string toStr(); // Get string representation if possible
 	[[nodiscard]] bool isPersistentType() const; // Can the type be changed?
@@ -207,4 +422,9 @@ private:
 	bool persistentType = false; /* I.e. the objects of a string contaner are
 							always chars*/
 	bool constness = false;
+	bool proxy = false;
+	// A proxy for the element of the container at index. Its value is set by the caller
+	static Object& makeProxy(PackedContainer, size_t index);
+	friend class ArrayContainer; // Make the proxies
+	friend class StringContainer;
 };
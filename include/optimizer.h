@@ -0,0 +1,56 @@
+/* optimizer.h */
+
+#pragma once
+#include <map>
+#include <string>
+#include "arena.h"
+#include "scope.h"
+
+class ASTNode;
+class CodeBlock;
+class IDNode;
+class LiteralNode;
+class ConstantPool;
+
+/* The optimizer runs over the AST after parsing (with -O1), before the resolver. It
+ * replaces the operators whose operands are all literals with a literal of the result,
+ * computed with the same operators as the execution. If the operator would throw, or
+ * trap like an integer division by zero, it's left to do so at runtime. Lists of literals become literals too.
+ * It also propagates the variables that are assigned only once in the whole program, by
+ * a plain assignment of a number, bool or char in the main block (i.e. N = 10). Their uses
+ * after the assignment are replaced with the value, and can then be folded too. This
+ * needs the assignments of the whole program, so the AST is visited twice: the first
+ * pass folds and counts the assignments, the second propagates the variables. */
+class Optimizer
+{
+public:
+	// The scope with the hardcoded objects, and the arena and constant pool of the
+	// program, where the new nodes and their values are put
+	Optimizer(const Scope& globalScope, Arena& arena, ConstantPool& pool);
+	void optimize(CodeBlock* mainBlock);
+
+	// Used by the nodes
+	void enterBlock();
+	void exitBlock();
+	void enterFunction();
+	void exitFunction();
+	void setRoot(const ASTNode*); // The root of the current expression statement
+	[[nodiscard]] bool isRoot(const ASTNode*) const;
+	void addWrite(const ASTNode* target); // The node is assigned to
+	void define(const ASTNode* target, const ASTNode* value); // target = value
+	// The function called doesn't assign to its arguments
+	[[nodiscard]] bool isPureCallee(const ASTNode* callee) const;
+	ASTNode* evaluate(ASTNode* node); // The operands of node are all literals
+	ASTNode* propagate(IDNode* node); // Value of the variable, if it is constant
+private:
+	const Scope& globalScope;
+	Arena& arena;
+	ConstantPool& pool;
+	Scope emptyScope; // Used to evaluate the constant nodes
+	bool propagating = false; // Second pass
+	int blockDepth = 0; // The main block is at depth 1
+	int functionDepth = 0;
+	const ASTNode* root = nullptr;
+	std::map<std::string, int> writes{}; // Number of assignments of each name
+	std::map<std::string, const LiteralNode*> constants{}; // Propagated variables
+};
@@ -46,6 +46,8 @@ enum class OperatorType
 };
 
 #include <map>
+#include "arena.h"
+#include "constants.h"
 #include "lexer.h"
 #include "AST.h"
 
@@ -60,14 +62,28 @@ class Scope;
 using OT = OperatorType;
 using TT = Lexer::TokenType;
 
+struct Program
+{ // The result of parsing. The nodes live in the arena and are all freed with it
+	Arena arena;
+	ConstantPool constants; // The values of the literals
+	CodeBlock* mainBlock = nullptr;
+};
+
 class Parser
 {
 public:
 	Parser();
-	CodeBlock* getAST(const std::string&);
+	Program getAST(const std::string&);
 
 private:
 	Lexer lexer;
+	Arena arena; // Holds the nodes of the AST
+	ConstantPool constants; // Holds the values of the literals
+
+	template <typename T>
+	ASTNode* makeLiteral(const T& val, size_t pos); // A literal of the pooled value
+	// A list init. node, or a literal if all the elements are literals
+	ASTNode* makeList(std::vector<ASTNode*>, size_t pos);
 
 	// Each precedence group consists of a map linking tokens to their corresponding
 	// operators, and a pointer to a function to parse those operators
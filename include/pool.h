@@ -0,0 +1,39 @@
+/* pool.h */
+
+#pragma once
+#include <cstddef>
+#include <ostream>
+
+/* Free lists for the small objects allocated at runtime: Objects and the boxes of
+ * containers and functions (see Ref). Sizes are rounded up to a multiple of 16 bytes,
+ * and each size class keeps its freed blocks to reuse them. When a list is empty, a
+ * slab of blocks is taken from the heap at once. The lists are thread local, the slabs
+ * are never returned to the heap. Bigger objects use the global new/delete. */
+class Pool
+{
+public:
+	[[nodiscard]] static void* allocate(size_t size);
+	static void deallocate(void* ptr, size_t size);
+	static void printStats(std::ostream&); // Hits and misses of each size class
+private:
+	static constexpr size_t GRANULARITY = 16;
+	static constexpr size_t MAX_SIZE = 256;
+	static constexpr size_t N_CLASSES = MAX_SIZE / GRANULARITY;
+	static constexpr size_t SLAB_SIZE = 16 * 1024;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct SizeClass
+	{
+		FreeBlock* freeList = nullptr;
+		size_t hits = 0; // Allocations served by the free list
+		size_t misses = 0; // Allocations that needed a new slab
+	};
+
+	static void refill(SizeClass&, size_t blockSize);
+	static thread_local SizeClass classes[N_CLASSES];
+	static thread_local size_t largeAllocs; // Too big for the pool
+};
@@ -0,0 +1,47 @@
+/* resolver.h */
+
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "scope.h"
+
+class CodeBlock;
+
+/* The resolver runs over the AST once, before execution, and binds every identifier to
+ * the slots it may be stored in. It follows the same levels as the execution: every
+ * code block, the counter of a for loop and the parameters of a function get a frame.
+ * Each name assigned to in a frame gets a slot in it. A variable is still only created
+ * on its first assignment, so an identifier is bound to all the slots of the name in
+ * the enclosing frames, and the first non-empty one is used (the one with the highest
+ * scope level, like Scope::getObj).
+ * The frames outside of a function depend on where it's called from, so there the
+ * variables are still looked up by name. The hardcoded functions are always at level 0. */
+class Resolver
+{
+public:
+	explicit Resolver(const Scope& globalScope); // The scope with the hardcoded objects
+	void resolve(CodeBlock* mainBlock);
+
+	// Used by the nodes
+	void enterFunction();
+	void exitFunction();
+	void enterFrame();
+	size_t exitFrame(); // Returns the number of slots of the frame
+	Binding bind(const std::string& id, bool lSide);
+private:
+	struct Frame
+	{
+		std::map<std::string, int> slots{};
+	};
+
+	struct Unit // The main program or a function
+	{
+		std::vector<Frame> frames{};
+		int firstDepth = 0; // The main block is at level 1, after the hardcoded objects
+		bool isFunction = false;
+	};
+
+	const Scope& globalScope;
+	std::vector<Unit> units{};
+};
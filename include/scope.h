@@ -2,61 +2,94 @@
 
 #pragma once
 #include <string>
-#include <map>
+#include <vector>
 
 class Object;
 
+struct SlotRef
+{ // A variable's slot in a frame. Depth is counted from the base of the function
+	int depth = 0;
+	int slot = 0;
+};
+
+struct Binding
+{ // Where an identifier can be found, set by the resolver (see resolver.h)
+	std::vector<SlotRef> slots{}; // Candidate slots, from the innermost frame out
+	int builtin = -1; // Slot in the frame of the hardcoded functions
+	bool dynamic = true; // Search by name if not found (outside of the function)
+	int symbol = -1; // See Scope::getSymbol
+};
 
 class Scope
 {
 public:
 	Scope();
 
-	class ObjKey
-		// It's defined so that a smaller scopelevel corresponds to smaller ObjKey
-	{
-	public:
-		ObjKey();
-		ObjKey(int, int, std::string);
-		// A key involves the scope and function levels, as well as the ID
-		int scopeLevel = 0;
-		int funcLevel = 0;
-		std::string ID;
-
-		bool operator<(const ObjKey& rhs) const // Overload < operator
-		{
-			// Lexicographical (dictionary-like) comparison w.r.t scopeLevel and ID
-			return std::tie(scopeLevel, ID) < std::tie(rhs.scopeLevel, rhs.ID);
-		}
-	};
-
-	using ObjMap = std::map<ObjKey, Object*>;
-	// That way the map is constructed with increasing scopelevel objects
-
-	ObjMap& getMap(); // 
 	[[nodiscard]] int getLevel() const;
 	[[nodiscard]] int getFuncLevel() const;
 	// Functions used to increase/decrease levels
-	void incLevel();
+	void incLevel(size_t nSlots = 0); // A frame with nSlots slots is pushed
 	void incFuncLevel();
-	void decrLevel();
+	void decrLevel(); // The frame on top is popped and its objects deleted
 	void decrFuncLevel();
-	void setScopeLevel(int); // Set specific levels
-	void setFuncLevel(int);
+	// A function call pushes the parameters' frame, linked to the frames the function
+	// can access. The caller's frames stay where they are, nothing is copied.
+	void enterFunction(int definedFuncLevel, size_t nParams);
+	void exitFunction(); // Pops the function's frames and restores the caller's levels
+	// Whether obj is a variable of the function being run, which exitFunction() frees
+	[[nodiscard]] bool isLocal(const Object* obj) const;
 	// Existing (user's) objects must be added by passing pointers to scope
 	void addObj(const Object& obj, const std::string& id, bool isConst = false);
 	// Hardcoded objects (ExternalFunctions) are passed as arguments
 	void addObj(Object*, const std::string& id, bool isConst = false);
 	Object* getObj(const std::string& id); // Get pointer of object with said ID
 	[[nodiscard]] bool checkObj(const std::string& id); // Does this var exist?
-	Scope* getRestricted(int);
+	// Resolved lookups. The slots are tried first, so that names are only compared
+	// when the variable can be outside of the current function
+	Object* getObj(const Binding&, const std::string& id);
+	// Like getObj, but creates the variable in the innermost candidate slot if needed
+	Object* getOrAddObj(const Binding&, const std::string& id);
+	[[nodiscard]] int getSlot(const std::string& id, int level) const;
 	void enableExternalFunctions(); // Load hardcoded functions (i.e. output)
+	// Names are compared as symbols, which are unique numbers for each identifier
+	static int getSymbol(const std::string& id);
 private:
-	ObjMap scopeMap{};
+	struct Entry
+	{
+		int symbol = -1; // Set when the slot is assigned an object
+		Object* obj = nullptr;
+	};
+
+	struct Frame
+	{
+		size_t start = 0; // Index of the frame's first entry
+		int funcLevel = 0;
+		int parent = -1; // The frame below this one, as seen from this frame
+		int nObjects = 0; // Number of non-empty slots
+	};
+
+	struct Call // The levels of the caller, restored when the function returns
+	{
+		int baseLevel = 0;
+		int funcLevel = 0;
+	};
+
+	Object* getObj(int symbol); // Lookup by name, from the top frame down
+	static int findSymbol(const std::string& id); // -1 if the name is not known
+
+	[[nodiscard]] size_t getEnd(size_t frame) const; // One past its last entry
+
+	// The frames are stored contiguously, with the entries of the highest scope level
+	// at the end. Entering and exiting a scope only touches the frame on top. The
+	// vectors keep their capacity, so frames and slots are reused by later calls.
+	std::vector<Entry> entries{};
 	// Scope level increases when we enter a nested scope (i.e. in a code block).
 	// When a variable at a higher scope level has the same identifier as one in a lower,
-	// the one in the higher will be chosen if the name is mentioned
-	int scopeLevel = 0;
+	// the one in the higher will be chosen if the name is mentioned. The scope level is
+	// the index of the frame on top. The frames of a function are linked to the ones
+	// it can access, skipping the frames of its callers.
+	std::vector<Frame> frames{Frame()};
+	std::vector<Call> calls{};
 	// Func level increases by one each time we enter a function scope. Each function has
 	// access to variables outside each scope. These variables must have been
 	// Defined at a func level lower or equal to the func level of the function definition,
@@ -65,6 +98,7 @@ private:
 	// vars a, b, c in A, then func B has access to a, b, c, and all the vars defined
 	// outside of A.
 	int funcLevel = 0;
+	int baseLevel = 0; // Slots are indexed relative to this level
 };
 
 #include "object.h"
@@ -0,0 +1,41 @@
+/* vm.h */
+
+#pragma once
+#include <vector>
+#include "bytecode.h"
+#include "object.h"
+#include "scope.h"
+
+class VM // Executes compiled units
+{
+public:
+	VM();
+	// Runs a unit in the given scope. The value of a return statement is copied
+	// to result, which is left untouched if the unit ends without one.
+	void run(const Proto&, Scope*, Object& result);
+private:
+	struct Register
+	{
+		Object* ref = nullptr; // Refers to an existing object, if set
+		Object value; // Otherwise the register holds a value of its own
+		Register();
+		Register(Register&&) noexcept; // Keeps refs into owned containers valid
+	};
+
+	static Object* get(Register&);
+	Object* operand(Register&); // Same as get, but cannot be void
+	static void setValue(Register&, Object&&);
+	// Sets reg to an object changed by an operator (i.e. =), which is its result
+	static void setChanged(Register&, Object& changed);
+	// R[a] = R[b] op R[c] for the operators that handle numbers directly
+	void applyNumerical(Register& reg, OpCode, Register& left, Register& right);
+	void call(size_t reg, uint32_t nArgs, Scope*); // Calls registers[reg]
+	// Calls the method of the receiver in reg, with the arguments in the next registers
+	void callMethod(Register& reg, const MethodCall&, uint32_t nArgs);
+
+	std::vector<Register> registers; // Register windows of all active units
+	size_t top = 0; // First register not used by any unit
+	std::vector<Object*> argBuffer; // Arguments of the call being made
+	Object voidObject; // Referred to by registers holding nothing
+	Object rightTmp; // Not used by the numerical operators
+};
@@ -1,14 +1,9 @@
 /* AST.cpp */
 
 #include "AST.h"
+#include "argstack.h"
 #include "errors.h"
-
-// Overload structure - idiom
-template <class... Ts>
-struct overload : Ts...
-{
-	using Ts::operator()...;
-};
+#include <algorithm>
 
 Object& checkLval(const Object& obj)
 {
@@ -21,41 +16,41 @@ Object& checkLval(const Object& obj)
 	return const_cast<Object&>(obj);
 }
 
-// Cleans temporary objects created in the evaluation of an expression
-// (i.e. in a = 5 + 3*2, the object with value 3*2 is temporary)
-static void cleanTmps(const std::initializer_list<Object*> tmpList)
+Object* takeResult(Object* result, Object& tmp)
 {
-	for (const Object* oPtr : tmpList)
-	{
-		if (oPtr) // If the pointer is valid
-		{
-			if (!oPtr->isLval())
-			// If they're not lValues (i.e. variables in the scope), delete them
-			{
-				delete oPtr;
-			}
-		}
-	}
+	if (!result || result->isLval()) return result;
+	tmp.data = std::move(result->data);
+	delete result;
+	return &tmp;
 }
 
-CodeBlock::CodeBlock() = default;
-
-CodeBlock::~CodeBlock() // Each statement must be deleted
+Object* storeBack(Object* changed, Object* result, Object& tmp)
 {
-	for (const Statement* st : statementVec)
+	if (!changed->isProxy()) return result;
+	if (result == changed)
 	{
-		delete st;
+		tmp = *changed;
+		result = &tmp;
 	}
+	changed->storeBack();
+	return result;
 }
 
+CodeBlock::CodeBlock() = default;
+
+CodeBlock::~CodeBlock() = default; // The nodes are freed with the arena (see Program)
+
 Object* CodeBlock::eval(Scope* scope, const bool isInFunction) const
 {
 	Object* tmpObj = nullptr;
-	scope->incLevel(); // Increase scope level
+	scope->incLevel(nSlots); // Increase scope level
+	const size_t writeMark = WriteLocks::mark();
 	for (Statement* st : statementVec)
 	{
 		// Execute all statements
-		if ((tmpObj = st->eval(scope, isInFunction)) != nullptr)
+		tmpObj = st->eval(scope, isInFunction);
+		WriteLocks::release(writeMark); // The containers it changed
+		if (tmpObj != nullptr)
 		{
 			// If we get something that isn't nullptr, a return statement has been run
 			break;
@@ -70,17 +65,15 @@ void CodeBlock::addStatement(Statement* st)
 	statementVec.push_back(st);
 }
 
+size_t CodeBlock::getSlotCount() const { return nSlots; }
+
 Statement::Statement() = default;
 Statement::~Statement() = default;
 Object* Statement::eval(Scope*, bool) { return nullptr; }
 
 WhileStatement::WhileStatement() = default;
 
-WhileStatement::~WhileStatement() // Delete branches that cease to be of use
-{
-	delete condition;
-	delete block;
-}
+WhileStatement::~WhileStatement() = default;
 
 WhileStatement::WhileStatement(ASTNode* condition, CodeBlock* block,
                                size_t position) : condition(condition),
@@ -91,14 +84,17 @@ WhileStatement::WhileStatement(ASTNode* condition, CodeBlock* block,
 
 Object* WhileStatement::eval(Scope* scope, const bool isInFunction)
 {
-	Object* conditionObj = nullptr;
+	const HoistedNode::LoopGuard guard(hoisted);
+	Object conditionTmp; // Holds the condition if it's a temporary
 	Object* tmpObj = nullptr;
-	while ((conditionObj = condition->eval(scope))->isTrue())
+	const size_t writeMark = WriteLocks::mark();
+	while (true)
 	{
+		const bool isTrue = condition->eval(scope, conditionTmp)->isTrue();
+		WriteLocks::release(writeMark); // The containers the condition changed
+		if (!isTrue) break;
 		// As long as it is true
 		tmpObj = block->eval(scope, isInFunction);
-		cleanTmps({conditionObj});
-		// The result of the condition changes each time
 		if (tmpObj != nullptr) break;
 	}
 	return tmpObj;
@@ -106,13 +102,7 @@ Object* WhileStatement::eval(Scope* scope, const bool isInFunction)
 
 ForStatement::ForStatement() = default;
 
-ForStatement::~ForStatement()
-{
-	delete counterNode;
-	delete upperNode;
-	delete lowerNode;
-	delete block;
-}
+ForStatement::~ForStatement() = default;
 
 ForStatement::ForStatement(ASTNode* counterNode, ASTNode* lowerNode,
                            ASTNode* upperNode, CodeBlock* block,
@@ -125,11 +115,13 @@ ForStatement::ForStatement(ASTNode* counterNode, ASTNode* lowerNode,
 
 Object* ForStatement::eval(Scope* scope, const bool isInFunction)
 {
-	Object *lowerObj = lowerNode->eval(scope), *upperObj = upperNode->
-		       eval(scope);
-	scope->incLevel();
+	const HoistedNode::LoopGuard guard(hoisted);
+	Object lowerTmp, upperTmp, counterTmp;
+	Object *lowerObj = lowerNode->eval(scope, lowerTmp), *upperObj = upperNode->
+		       eval(scope, upperTmp);
+	scope->incLevel(1);
 	// The counter variable exists in an inner scope (only available to the block)
-	Object* counterObj = counterNode->eval(scope, true);
+	Object* counterObj = counterNode->eval(scope, counterTmp, true);
 	// lSide = true, to allow initialization of the variable instead of searching for it.
 	// It is like doing var = 0.
 
@@ -139,31 +131,29 @@ Object* ForStatement::eval(Scope* scope, const bool isInFunction)
 
 	*counterObj = *lowerObj;
 	Object* tmpObj = nullptr;
+	if (counted) // The limits are the same in every iteration
+	{
+		tmpObj = countedLoop(*counterObj, *upperObj,
+		                     [&] { return block->eval(scope, isInFunction); });
+		scope->decrLevel();
+		return tmpObj;
+	}
 	while ((*counterObj <= *upperObj).isTrue())
 	{
 		tmpObj = block->eval(scope, isInFunction);
 		if (tmpObj != nullptr) break;
-		cleanTmps({lowerObj, upperObj});
-		lowerObj = lowerNode->eval(scope);
-		upperObj = upperNode->eval(scope);
+		lowerObj = lowerNode->eval(scope, lowerTmp);
+		upperObj = upperNode->eval(scope, upperTmp);
 		// Re-evaluate the limits (something may have changed)
 		++(*counterObj); // Increase the counter
 	}
-	cleanTmps({counterObj, lowerObj, upperObj});
 	scope->decrLevel();
 	return tmpObj;
 }
 
 IfStatement::IfStatement() = default;
 
-IfStatement::~IfStatement()
-{
-	for (const auto& [casePtr, blockPtr] : cases)
-	{
-		delete casePtr;
-		delete blockPtr;
-	}
-}
+IfStatement::~IfStatement() = default;
 
 IfStatement::IfStatement(size_t position)
 {
@@ -186,23 +176,18 @@ Object* IfStatement::eval(Scope* scope, const bool isInFunction)
 	for (const auto& [casePtr, blockPtr] : cases)
 	{
 		// For each "case"
-		Object* caseObj = casePtr->eval(scope); // Evaluate the condition
-		if (caseObj->isTrue())
+		Object caseTmp;
+		if (casePtr->eval(scope, caseTmp)->isTrue()) // Evaluate the condition
 		{
-			cleanTmps({caseObj});
 			return blockPtr->eval(scope, isInFunction); // Run the block
 		}
-		cleanTmps({caseObj});
 	}
 	return nullptr;
 }
 
 ExprStatement::ExprStatement() = default;
 
-ExprStatement::~ExprStatement()
-{
-	delete exprRoot;
-}
+ExprStatement::~ExprStatement() = default;
 
 ExprStatement::ExprStatement(ASTNode* expr, size_t position) : exprRoot(expr)
 {
@@ -211,7 +196,8 @@ ExprStatement::ExprStatement(ASTNode* expr, size_t position) : exprRoot(expr)
 
 Object* ExprStatement::eval(Scope* scope, bool)
 {
-	cleanTmps({exprRoot->eval(scope)});
+	Object tmp;
+	exprRoot->eval(scope, tmp);
 	// The result of an expression is a pointer to the root, but in an expression
 	// statement it is discarded.
 	return nullptr;
@@ -219,10 +205,7 @@ Object* ExprStatement::eval(Scope* scope, bool)
 
 ReturnStatement::ReturnStatement() = default;
 
-ReturnStatement::~ReturnStatement()
-{
-	delete returnRoot;
-}
+ReturnStatement::~ReturnStatement() = default;
 
 ReturnStatement::ReturnStatement(ASTNode* expr, size_t position) : returnRoot(
 	expr)
@@ -237,24 +220,21 @@ Object* ReturnStatement::eval(Scope* scope, const bool isInFunction)
 		throw CustomError("Return statements should only be inside functions.",
 		                  pos);
 	}
-	Object* returnObj = returnRoot->eval(scope);
-	const auto newObj = new Object(*returnObj);
-	// Copies the return value to a knew object
-	cleanTmps({returnObj});
+	Object tmp;
+	Object* returnObj = returnRoot->eval(scope, tmp);
+	if (!returnObj) throw FatalError("", pos);
+	// Copies the return value to a new object. A temporary, or a variable of the function
+	// (which is freed on return), can just be moved
+	const auto newObj = new Object;
+	if (returnObj == &tmp || scope->isLocal(returnObj))
+		newObj->data = std::move(returnObj->data);
+	else *newObj = *returnObj;
 	return newObj;
 }
 
 FunctionDefStatement::FunctionDefStatement() = default;
 
-FunctionDefStatement::~FunctionDefStatement()
-{
-	delete block;
-	delete funcID;
-	for (const ASTNode* node : funcParams)
-	{
-		delete node;
-	}
-}
+FunctionDefStatement::~FunctionDefStatement() = default;
 
 FunctionDefStatement::FunctionDefStatement(ASTNode* funcID,
                                            std::vector<ASTNode*> funcParams,
@@ -268,7 +248,8 @@ FunctionDefStatement::FunctionDefStatement(ASTNode* funcID,
 
 Object* FunctionDefStatement::eval(Scope* scope, bool)
 {
-	*funcID->eval(scope, true) = Object(
+	Object tmp;
+	*funcID->eval(scope, tmp, true) = Object(
 		Function(block, funcParams, scope->getFuncLevel()));
 	// Evaluate the ID node to create a Function object
 	// Get the current func level so that the Function knows which variables it can
@@ -279,15 +260,25 @@ Object* FunctionDefStatement::eval(Scope* scope, bool)
 ASTNode::ASTNode() = default;
 ASTNode::~ASTNode() = default;
 void ASTNode::setForceRval(bool isIt) { forceRval = isIt; }
-Object* ASTNode::eval(Scope*, bool) { return nullptr; }
+bool ASTNode::isForceRval() const { return forceRval; }
+void ASTNode::setWritten() { written = true; }
+size_t ASTNode::getPos() const { return pos; }
+Object* ASTNode::eval(Scope*, Object&, bool) { return nullptr; }
 
-nAryNode::nAryNode() = default;
-
-nAryNode::~nAryNode()
+Object* ASTNode::call(Scope* scope, Object& calleeTmp, Args args)
 {
-	delete mainOperand;
-	for (const ASTNode* opPtr : nOperands) { delete opPtr; }
+	Object* callee = eval(scope, calleeTmp);
+	if (!callee) { throw FatalError("", pos); }
+	return (*callee)(scope, args);
 }
+bool ASTNode::isCall() const { return false; }
+bool ASTNode::isMethod() const { return false; }
+bool ASTNode::isPure() const { return false; }
+bool ASTNode::isPureMethod() const { return false; }
+
+nAryNode::nAryNode() = default;
+
+nAryNode::~nAryNode() = default;
 
 nAryNode::nAryNode(ASTNode* mainOperand, const OperatorType opType,
                    std::vector<ASTNode*> nOperands, size_t position) :
@@ -296,31 +287,86 @@ nAryNode::nAryNode(ASTNode* mainOperand, const OperatorType opType,
 		std::move(nOperands))
 {
 	pos = position;
+	if (opType == OperatorType::SUBSCRIPT)
+	{
+		const size_t nIndices = this->nOperands.size();
+		auto* inner = dynamic_cast<nAryNode*>(mainOperand);
+		if (inner && inner->opType == OperatorType::SUBSCRIPT)
+		{ // The indices of the inner subscript go first
+			this->mainOperand = inner->mainOperand;
+			this->nOperands.insert(this->nOperands.begin(), inner->nOperands.begin(),
+			                       inner->nOperands.end());
+			chain = inner->chain;
+		}
+		chain.push_back({nIndices, pos});
+	}
+	// input(A[0]) assigns to its argument
+	const auto* callee = dynamic_cast<IDNode*>(mainOperand);
+	if (opType == OperatorType::FUNCTION_CALL && callee && callee->getID() == "input")
+	{
+		for (ASTNode* node : this->nOperands) node->setWritten();
+	}
 }
 
-Object* nAryNode::eval(Scope* scope, bool)
+void nAryNode::setWritten()
+{
+	written = true;
+	// I.e. in A[0][1] = 1, the element of A is changed too
+	if (opType == OperatorType::SUBSCRIPT) mainOperand->setWritten();
+}
+
+bool nAryNode::isCall() const { return opType == OperatorType::FUNCTION_CALL; }
+
+bool nAryNode::isPure() const
+{
+	// Reading an element changes nothing, a call may unless it's of a method like size()
+	if (written) return false;
+	if (opType == OperatorType::FUNCTION_CALL)
+	{
+		if (!mainOperand->isPureMethod()) return false;
+	}
+	else if (mainOperand && !mainOperand->isPure()) return false;
+	return std::all_of(nOperands.begin(), nOperands.end(),
+	                   [](const ASTNode* node) { return node->isPure(); });
+}
+
+Object* nAryNode::eval(Scope* scope, Object& tmp, bool)
 {
 	Object* result = nullptr;
-	Object* mainObject = nullptr; // I.e. in function call it's the function ID
-	std::vector<Object*> nObjects; // To store the operands
-	for (ASTNode* node : nOperands) // Evaluate all nodes to objects
+	Object mainTmp; // I.e. in function call it's the function ID
+	// The operands, and the temporary ones, are held in the argument stack
+	const ArgStack::Frame operands(nOperands.size());
+	for (size_t i = 0; i != nOperands.size(); i++) // Evaluate all nodes to objects
 	{
-		nObjects.push_back(node->eval(scope));
+		operands.arg(i) = nOperands[i]->eval(scope, operands.tmp(i));
 	}
+	const Args nObjects = operands.getArgs();
 	try
 	{
+		Object* mainObject = nullptr;
 		switch (opType) 
 		{
 		case OperatorType::SUBSCRIPT:
-			mainObject = mainOperand->eval(scope);
-			result = (*mainObject)[nObjects]; // Use overloaded operators
+			mainObject = mainOperand->eval(scope, mainTmp);
+			result = subscript(mainObject, nObjects, tmp);
+			if (mainObject == &mainTmp && result != &tmp)
+			{ // An element of a temporary container must outlive it
+				tmp = *result;
+				result->storeBack();
+				result = &tmp;
+			}
 			break;
 		case OperatorType::FUNCTION_CALL:
-			mainObject = mainOperand->eval(scope);
-			result = (*mainObject)(scope, nObjects);
+			result = takeResult(mainOperand->call(scope, mainTmp, nObjects), tmp);
+			// The arguments may have been changed, i.e. input(A[0])
+			for (auto obj = nObjects.rbegin(); obj != nObjects.rend(); ++obj)
+			{
+				if (*obj) (*obj)->storeBack();
+			}
 			break;
 		case OperatorType::LIST_INIT: // List init. returns an array
-			result = new Object(std::make_shared<ArrayContainer>(nObjects));
+			tmp.data = makeRef<ArrayContainer>(nObjects);
+			result = &tmp;
 			break;
 		default:
 			break;
@@ -334,33 +380,117 @@ Object* nAryNode::eval(Scope* scope, bool)
 		if (!ce.isPosSet()) ce.setPos(pos);
 		throw;
 	}
-	cleanTmps({mainObject}); // Clean temporary objects
-	for (Object* objPtr : nObjects)
+	return result;
+}
+
+Object* nAryNode::subscript(Object* obj, Args indices,
+                            Object& tmp) const
+{
+	try
+	{
+		// Arrays find the element of a chain with a single lookup (see ArrayContainer)
+		if (chain.size() == 1 || std::holds_alternative<Ref<ArrayContainer>>(obj->data))
+		{
+			return (written) // Use overloaded operators
+				       ? (obj->getWritable(indices))
+				       : (obj->getElement(indices, tmp));
+		}
+	}
+	catch (CustomError&)
 	{
-		cleanTmps({objPtr});
+		if (chain.size() == 1) throw;
+		// The error is the one of the subscript that fails when they are applied
+		// separately, which is found below
 	}
-	return result;
+	const ArgStack::Frame tmps(chain.size());
+	size_t first = 0;
+	for (size_t i = 0; i != chain.size(); i++)
+	{
+		const Args group = indices.subspan(first, chain[i].nIndices);
+		first += chain[i].nIndices;
+		try
+		{
+			obj = (written) ? (obj->getWritable(group)) : (obj->getElement(group, tmps.tmp(i)));
+		}
+		catch (CustomError& ce)
+		{
+			if (!ce.isPosSet()) ce.setPos(chain[i].pos);
+			throw;
+		}
+	}
+	// Not reached, as a subscript of a char always fails
+	tmp = *obj;
+	obj->storeBack();
+	return &tmp;
 }
 
 BinaryNode::BinaryNode() = default;
 
-BinaryNode::~BinaryNode()
-{
-	delete left;
-	delete right;
-}
+BinaryNode::~BinaryNode() = default;
 
 BinaryNode::BinaryNode(ASTNode* l, ASTNode* r, OperatorType opType,
                        size_t position) : opType(opType), left(l), right(r)
 {
 	pos = position;
+	switch (opType)
+	{
+	case OperatorType::MEMBER_ACCESS:
+		methodID = dynamic_cast<IDNode*>(r);
+		// I.e. A[0].push(1) changes the element of A
+		if (methodID && isModifyingMethod(methodID->getID())) l->setWritten();
+		break;
+	case OperatorType::ASSIGNMENT:
+	case OperatorType::ADDITION_ASSIGN:
+	case OperatorType::SUBTRACTION_ASSIGN:
+	case OperatorType::MULTIPLICATION_ASSIGN:
+	case OperatorType::DIVISION_ASSIGN:
+	case OperatorType::MODULO_ASSIGN:
+	case OperatorType::DIV_ASSIGN:
+		l->setWritten();
+		break;
+	default:
+		break;
+	}
 }
 
-Object* BinaryNode::eval(Scope* scope, const bool lSide)
+bool BinaryNode::isMethod() const { return opType == OperatorType::MEMBER_ACCESS; }
+
+bool BinaryNode::isPure() const
 {
+	switch (opType)
+	{
+	case OperatorType::MEMBER_ACCESS: // Only a method value, but it's usually called
+	case OperatorType::ASSIGNMENT:
+	case OperatorType::ADDITION_ASSIGN:
+	case OperatorType::SUBTRACTION_ASSIGN:
+	case OperatorType::MULTIPLICATION_ASSIGN:
+	case OperatorType::DIVISION_ASSIGN:
+	case OperatorType::MODULO_ASSIGN:
+	case OperatorType::DIV_ASSIGN:
+		return false;
+	default:
+		return left->isPure() && right->isPure();
+	}
+}
+
+bool BinaryNode::isPureMethod() const
+{
+	// The value of the member access itself isn't, it pins the receiver (see bindMethod)
+	return opType == OperatorType::MEMBER_ACCESS && methodID &&
+		!isModifyingMethod(methodID->getID()) && left->isPure();
+}
+
+Object* BinaryNode::eval(Scope* scope, Object& tmp, const bool lSide)
+{
+	return (this->*handler)(scope, tmp, lSide); // Generic or quickened
+}
+
+Object* BinaryNode::evalGeneric(Scope* scope, Object& tmp, const bool lSide)
+{
+	Object leftTmp; // Hold the operands if they are temporary
 	// Allow new variable initialization
 	Object* oLeft = left->eval(
-		scope, (opType == OperatorType::ASSIGNMENT) ? (true) : (false));
+		scope, leftTmp, (opType == OperatorType::ASSIGNMENT) ? (true) : (false));
 	/* In the assignment operator, the left node should be passed with lSide = true.
 	 * This allows it to be initialized if needed. */
 	Object* result = nullptr;
@@ -369,117 +499,22 @@ Object* BinaryNode::eval(Scope* scope, const bool lSide)
 	{
 		if (opType == OperatorType::MEMBER_ACCESS) // Used to access methods
 		{
-			/*Member access refers to accessing methods in certain objects. An node
-			 * containing the pointer name (right) searches in the method scope of the
-			 * object. It retrieves an external function which executes the method.*/
-			std::visit(overload{
-				           [&result, this](std::shared_ptr<StackContainer>& sc)
-				           {
-					           result = right->eval(&sc->getMethodScope());
-				           },
-				           [&result, this](std::shared_ptr<QueueContainer>& qc)
-				           {
-					           result = right->eval(&qc->getMethodScope());
-				           },
-				           [&result, this](std::shared_ptr<ArrayContainer>& ac)
-				           {
-					           result = right->eval(&ac->getMethodScope());
-				           },
-				           [&result, this](
-				           std::shared_ptr<CollectionContainer>& cc)
-				           {
-					           result = right->eval(&cc->getMethodScope());
-				           },
-				           [&result, this](std::shared_ptr<StringContainer>& sc)
-				           {
-					           result = right->eval(&sc->getMethodScope());
-				           },
-				           [](auto&)
-				           { 
-					           throw TypeError(
-						           "Object does not contain methods.");
-				           }
-			           }, oLeft->data);
+			/* Member access refers to accessing methods in certain objects. The method
+			 * name (right) is looked up in the methods of the object's type. As a value,
+			 * the method is bound to the object's container. */
+			tmp = Object(bindMethod(*oLeft, resolveMethod(*oLeft)));
+			result = &tmp;
 		}
 		else
 		{
-			Object* oRight = right->eval(scope, lSide); // Get the rhs object
+			Object rightTmp;
+			Object* oRight = right->eval(scope, rightTmp, lSide); // Get the rhs object
 			if (!oRight) { throw FatalError("", pos); }
-			switch (opType) // Apply different operators
-			{ // Overloaded operators are used, the result is a new object
-			case OperatorType::ADDITION:
-				result = new Object(*oLeft + *oRight);
-				break;
-			case OperatorType::SUBTRACTION:
-				result = new Object(*oLeft - *oRight);
-				break;
-			case OperatorType::MULTIPLICATION:
-				result = new Object(*oLeft * *oRight);
-				break;
-			case OperatorType::DIVISION:
-				result = new Object(*oLeft / *oRight);
-				break;
-			case OperatorType::MODULO:
-				result = new Object(*oLeft % *oRight);
-				break;
-			case OperatorType::DIV:
-				result = new Object(operatorDiv(*oLeft, *oRight));
-				break;
-			case OperatorType::LESS:
-				result = new Object(*oLeft < *oRight);
-				break;
-			case OperatorType::LESS_EQ:
-				result = new Object(*oLeft <= *oRight);
-				break;
-			case OperatorType::GREATER:
-				result = new Object(*oLeft > *oRight);
-				break;
-			case OperatorType::GRE_EQ:
-				result = new Object(*oLeft >= *oRight);
-				break;
-			case OperatorType::EQUAL:
-				result = new Object(*oLeft == *oRight);
-				break;
-			case OperatorType::NOT_EQUAL:
-				result = new Object(*oLeft != *oRight);
-				break;
-			case OperatorType::OR:
-				result = new Object(*oLeft || *oRight);
-				break;
-			case OperatorType::AND:
-				result = new Object(*oLeft && *oRight);
-				break;
-			case OperatorType::ASSIGNMENT:
-				result = &checkLval(*oLeft = *oRight);
-			// The result of assignment is the lhs operand. If it isn't an lVal, then
-			// assignment is impossible.
-				break;
-			case OperatorType::ADDITION_ASSIGN:
-				result = &checkLval(*oLeft += *oRight);
-				break;
-			case OperatorType::SUBTRACTION_ASSIGN:
-				result = &checkLval(*oLeft -= *oRight);
-				break;
-			case OperatorType::MULTIPLICATION_ASSIGN:
-				result = &checkLval(*oLeft *= *oRight);
-				break;
-			case OperatorType::DIVISION_ASSIGN:
-				result = &checkLval(*oLeft /= *oRight);
-				break;
-			case OperatorType::MODULO_ASSIGN:
-				result = &checkLval(*oLeft %= *oRight);
-				break;
-			case OperatorType::DIV_ASSIGN:
-				result = &checkLval(oLeft->operatorDivEq(*oRight));
-				break;
-
-			case OperatorType::COMMA:
-				result = (oRight->isLval()) ? (oRight) : (new Object(*oRight));
-				break;
-			default:
-				throw FatalError("", pos);
-			}
-			cleanTmps({oLeft, oRight}); // Clean the temporary objects
+			// The operands may change (i.e. +=), so their types are taken first
+			const size_t leftType = oLeft->data.index();
+			const size_t rightType = oRight->data.index();
+			result = storeBack(oLeft, apply(oLeft, oRight, rightTmp, tmp), tmp);
+			observe(leftType, rightType);
 		}
 	}
 	catch (CustomError& ce)
@@ -491,73 +526,390 @@ Object* BinaryNode::eval(Scope* scope, const bool lSide)
 	return result;
 }
 
+Object* BinaryNode::call(Scope* scope, Object& calleeTmp,
+                         Args args)
+{
+	if (opType != OperatorType::MEMBER_ACCESS) return ASTNode::call(scope, calleeTmp, args);
+	/* A method call (i.e. S.push(1)) calls the native method directly, with the container
+	 * as the receiver. The method found is cached along with the receiver's type, so
+	 * calls on receivers of the same type skip the lookup. A temporary receiver stays in
+	 * calleeTmp until the call returns. */
+	Object* receiver = left->eval(scope, calleeTmp);
+	if (!receiver) { throw FatalError("", pos); }
+	if (receiver->data.index() != cachedType)
+	{
+		cachedMethod = resolveMethod(*receiver);
+		cachedType = receiver->data.index();
+	}
+	return cachedMethod(*receiver, args);
+}
+
+Method BinaryNode::resolveMethod(Object& receiver) const
+{
+	if (!methodID) throw ParsingError("Method name expected.", pos);
+	Method method = nullptr;
+	try
+	{
+		method = findMethod(receiver, methodID->getID());
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(pos);
+		throw;
+	}
+	if (!method)
+	{
+		throw NameError("Object with identifier \'" + methodID->getID() +
+		                "\' does not exist in scope.", methodID->getPos());
+	}
+	return method;
+}
+
+template <OperatorType op>
+static Object* applyBinary(Object* oLeft, Object* oRight, Object& rightTmp, Object& tmp)
+{ // Overloaded operators are used, the result is stored in tmp
+	if constexpr (op == OperatorType::ADDITION) tmp.data = (*oLeft + *oRight).data;
+	else if constexpr (op == OperatorType::SUBTRACTION)
+		tmp.data = (*oLeft - *oRight).data;
+	else if constexpr (op == OperatorType::MULTIPLICATION)
+		tmp.data = (*oLeft * *oRight).data;
+	else if constexpr (op == OperatorType::DIVISION) tmp.data = (*oLeft / *oRight).data;
+	else if constexpr (op == OperatorType::MODULO) tmp.data = (*oLeft % *oRight).data;
+	else if constexpr (op == OperatorType::DIV)
+		tmp.data = operatorDiv(*oLeft, *oRight).data;
+	else if constexpr (op == OperatorType::LESS) tmp.data = (*oLeft < *oRight).data;
+	else if constexpr (op == OperatorType::LESS_EQ) tmp.data = (*oLeft <= *oRight).data;
+	else if constexpr (op == OperatorType::GREATER) tmp.data = (*oLeft > *oRight).data;
+	else if constexpr (op == OperatorType::GRE_EQ) tmp.data = (*oLeft >= *oRight).data;
+	else if constexpr (op == OperatorType::EQUAL) tmp.data = (*oLeft == *oRight).data;
+	else if constexpr (op == OperatorType::NOT_EQUAL)
+		tmp.data = (*oLeft != *oRight).data;
+	else if constexpr (op == OperatorType::OR) tmp.data = (*oLeft || *oRight).data;
+	else if constexpr (op == OperatorType::AND) tmp.data = (*oLeft && *oRight).data;
+	// The result of assignment is the lhs operand. If it isn't an lVal, then
+	// assignment is impossible.
+	else if constexpr (op == OperatorType::ASSIGNMENT) return &checkLval(*oLeft = *oRight);
+	else if constexpr (op == OperatorType::ADDITION_ASSIGN)
+		return &checkLval(*oLeft += *oRight);
+	else if constexpr (op == OperatorType::SUBTRACTION_ASSIGN)
+		return &checkLval(*oLeft -= *oRight);
+	else if constexpr (op == OperatorType::MULTIPLICATION_ASSIGN)
+		return &checkLval(*oLeft *= *oRight);
+	else if constexpr (op == OperatorType::DIVISION_ASSIGN)
+		return &checkLval(*oLeft /= *oRight);
+	else if constexpr (op == OperatorType::MODULO_ASSIGN)
+		return &checkLval(*oLeft %= *oRight);
+	else if constexpr (op == OperatorType::DIV_ASSIGN)
+		return &checkLval(oLeft->operatorDivEq(*oRight));
+	else if constexpr (op == OperatorType::COMMA)
+	{
+		if (oRight != &rightTmp) return oRight;
+		tmp.data = std::move(rightTmp.data);
+	}
+	return &tmp;
+}
+
+BinaryOperator binaryOperator(const OperatorType opType)
+{
+	switch (opType)
+	{
+	case OperatorType::ADDITION: return &applyBinary<OperatorType::ADDITION>;
+	case OperatorType::SUBTRACTION: return &applyBinary<OperatorType::SUBTRACTION>;
+	case OperatorType::MULTIPLICATION: return &applyBinary<OperatorType::MULTIPLICATION>;
+	case OperatorType::DIVISION: return &applyBinary<OperatorType::DIVISION>;
+	case OperatorType::MODULO: return &applyBinary<OperatorType::MODULO>;
+	case OperatorType::DIV: return &applyBinary<OperatorType::DIV>;
+	case OperatorType::LESS: return &applyBinary<OperatorType::LESS>;
+	case OperatorType::LESS_EQ: return &applyBinary<OperatorType::LESS_EQ>;
+	case OperatorType::GREATER: return &applyBinary<OperatorType::GREATER>;
+	case OperatorType::GRE_EQ: return &applyBinary<OperatorType::GRE_EQ>;
+	case OperatorType::EQUAL: return &applyBinary<OperatorType::EQUAL>;
+	case OperatorType::NOT_EQUAL: return &applyBinary<OperatorType::NOT_EQUAL>;
+	case OperatorType::OR: return &applyBinary<OperatorType::OR>;
+	case OperatorType::AND: return &applyBinary<OperatorType::AND>;
+	case OperatorType::ASSIGNMENT: return &applyBinary<OperatorType::ASSIGNMENT>;
+	case OperatorType::ADDITION_ASSIGN: return &applyBinary<OperatorType::ADDITION_ASSIGN>;
+	case OperatorType::SUBTRACTION_ASSIGN:
+		return &applyBinary<OperatorType::SUBTRACTION_ASSIGN>;
+	case OperatorType::MULTIPLICATION_ASSIGN:
+		return &applyBinary<OperatorType::MULTIPLICATION_ASSIGN>;
+	case OperatorType::DIVISION_ASSIGN: return &applyBinary<OperatorType::DIVISION_ASSIGN>;
+	case OperatorType::MODULO_ASSIGN: return &applyBinary<OperatorType::MODULO_ASSIGN>;
+	case OperatorType::DIV_ASSIGN: return &applyBinary<OperatorType::DIV_ASSIGN>;
+	case OperatorType::COMMA: return &applyBinary<OperatorType::COMMA>;
+	default: return nullptr;
+	}
+}
+
+Object* BinaryNode::apply(Object* oLeft, Object* oRight, Object& rightTmp, Object& tmp)
+{
+	const BinaryOperator op = binaryOperator(opType); // Apply different operators
+	if (!op) throw FatalError("", pos);
+	return op(oLeft, oRight, rightTmp, tmp);
+}
+
+// The operator for operands that both hold a T, nullptr if they don't (the guard)
+template <typename T, OperatorType op>
+static Object* applyQuick(Object* oLeft, Object* oRight, Object& tmp)
+{
+	T* x = std::get_if<T>(&oLeft->data);
+	const T* y = std::get_if<T>(&oRight->data);
+	// The results must be the same as the ones of the generic operators (i.e. < gives
+	// the type of the operands and <= gives a bool), and the cases where they throw or
+	// modify an rvalue are left to them
+	bool hit = x && y;
+	if constexpr (op == OperatorType::DIVISION && std::is_same_v<T, int>)
+		hit = hit && *y != 0;
+	if constexpr (op == OperatorType::ADDITION_ASSIGN ||
+		op == OperatorType::SUBTRACTION_ASSIGN)
+		hit = hit && oLeft->isLval() && !oLeft->isConst();
+	if (!hit) return nullptr;
+	if constexpr (op == OperatorType::ADDITION) tmp.data = static_cast<T>(*x + *y);
+	else if constexpr (op == OperatorType::SUBTRACTION)
+		tmp.data = static_cast<T>(*x - *y);
+	else if constexpr (op == OperatorType::MULTIPLICATION)
+		tmp.data = static_cast<T>(*x * *y);
+	else if constexpr (op == OperatorType::DIVISION) tmp.data = static_cast<T>(*x / *y);
+	else if constexpr (op == OperatorType::LESS) tmp.data = static_cast<T>(*x < *y);
+	else if constexpr (op == OperatorType::GREATER) tmp.data = static_cast<T>(*y < *x);
+	else if constexpr (op == OperatorType::EQUAL) tmp.data = static_cast<T>(*x == *y);
+	else if constexpr (op == OperatorType::LESS_EQ) tmp.data = !(*y < *x);
+	else if constexpr (op == OperatorType::GRE_EQ) tmp.data = !(*x < *y);
+	else if constexpr (op == OperatorType::NOT_EQUAL) tmp.data = !(*x == *y);
+	else if constexpr (op == OperatorType::ADDITION_ASSIGN)
+	{
+		*x = static_cast<T>(*x + *y);
+		return oLeft;
+	}
+	else if constexpr (op == OperatorType::SUBTRACTION_ASSIGN)
+	{
+		*x = static_cast<T>(*x - *y);
+		return oLeft;
+	}
+	return &tmp;
+}
+
+// Tries two ints and two floats before the generic operator
+template <OperatorType op>
+static Object* applyNumerical(Object* oLeft, Object* oRight, Object& rightTmp, Object& tmp)
+{
+	if (Object* result = applyQuick<int, op>(oLeft, oRight, tmp)) return result;
+	if (Object* result = applyQuick<float, op>(oLeft, oRight, tmp)) return result;
+	return applyBinary<op>(oLeft, oRight, rightTmp, tmp);
+}
+
+BinaryOperator numericalOperator(const OperatorType opType)
+{
+	switch (opType) // The operators that have specialized handlers
+	{
+	case OperatorType::ADDITION: return &applyNumerical<OperatorType::ADDITION>;
+	case OperatorType::SUBTRACTION: return &applyNumerical<OperatorType::SUBTRACTION>;
+	case OperatorType::MULTIPLICATION:
+		return &applyNumerical<OperatorType::MULTIPLICATION>;
+	case OperatorType::DIVISION: return &applyNumerical<OperatorType::DIVISION>;
+	case OperatorType::LESS: return &applyNumerical<OperatorType::LESS>;
+	case OperatorType::LESS_EQ: return &applyNumerical<OperatorType::LESS_EQ>;
+	case OperatorType::GREATER: return &applyNumerical<OperatorType::GREATER>;
+	case OperatorType::GRE_EQ: return &applyNumerical<OperatorType::GRE_EQ>;
+	case OperatorType::EQUAL: return &applyNumerical<OperatorType::EQUAL>;
+	case OperatorType::NOT_EQUAL: return &applyNumerical<OperatorType::NOT_EQUAL>;
+	case OperatorType::ADDITION_ASSIGN:
+		return &applyNumerical<OperatorType::ADDITION_ASSIGN>;
+	case OperatorType::SUBTRACTION_ASSIGN:
+		return &applyNumerical<OperatorType::SUBTRACTION_ASSIGN>;
+	default: return binaryOperator(opType);
+	}
+}
+
+void BinaryNode::observe(const size_t leftType, const size_t rightType)
+{
+	if (deopts >= MAX_DEOPTS) return;
+	if (leftType != rightType) // Mixed types aren't quickened
+	{
+		hits = 0;
+		return;
+	}
+	if (leftType != lastType) hits = 0;
+	lastType = leftType;
+	if (++hits < QUICKEN_AFTER) return;
+	hits = 0;
+	if (leftType == VariantType(0).index()) quicken<int>();
+	else if (leftType == VariantType(0.0f).index()) quicken<float>();
+}
+
+template <typename T>
+void BinaryNode::quicken()
+{
+	switch (opType) // Only some operators have specialized handlers
+	{
+	case OperatorType::ADDITION:
+		handler = &BinaryNode::evalQuick<T, OperatorType::ADDITION>;
+		break;
+	case OperatorType::SUBTRACTION:
+		handler = &BinaryNode::evalQuick<T, OperatorType::SUBTRACTION>;
+		break;
+	case OperatorType::MULTIPLICATION:
+		handler = &BinaryNode::evalQuick<T, OperatorType::MULTIPLICATION>;
+		break;
+	case OperatorType::DIVISION:
+		handler = &BinaryNode::evalQuick<T, OperatorType::DIVISION>;
+		break;
+	case OperatorType::LESS:
+		handler = &BinaryNode::evalQuick<T, OperatorType::LESS>;
+		break;
+	case OperatorType::LESS_EQ:
+		handler = &BinaryNode::evalQuick<T, OperatorType::LESS_EQ>;
+		break;
+	case OperatorType::GREATER:
+		handler = &BinaryNode::evalQuick<T, OperatorType::GREATER>;
+		break;
+	case OperatorType::GRE_EQ:
+		handler = &BinaryNode::evalQuick<T, OperatorType::GRE_EQ>;
+		break;
+	case OperatorType::EQUAL:
+		handler = &BinaryNode::evalQuick<T, OperatorType::EQUAL>;
+		break;
+	case OperatorType::NOT_EQUAL:
+		handler = &BinaryNode::evalQuick<T, OperatorType::NOT_EQUAL>;
+		break;
+	case OperatorType::ADDITION_ASSIGN:
+		handler = &BinaryNode::evalQuick<T, OperatorType::ADDITION_ASSIGN>;
+		break;
+	case OperatorType::SUBTRACTION_ASSIGN:
+		handler = &BinaryNode::evalQuick<T, OperatorType::SUBTRACTION_ASSIGN>;
+		break;
+	default:
+		break;
+	}
+}
+
+template <typename T, OperatorType op>
+Object* BinaryNode::evalQuick(Scope* scope, Object& tmp, const bool lSide)
+{
+	Object leftTmp, rightTmp;
+	Object* oLeft = left->eval(scope, leftTmp);
+	if (!oLeft) { throw FatalError("", pos); }
+	Object* oRight = nullptr;
+	try
+	{
+		oRight = right->eval(scope, rightTmp, lSide);
+		if (!oRight) { throw FatalError("", pos); }
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(pos);
+		throw;
+	}
+	if (Object* result = applyQuick<T, op>(oLeft, oRight, tmp))
+		return storeBack(oLeft, result, tmp);
+	handler = &BinaryNode::evalGeneric; // Deoptimize
+	deopts++;
+	try
+	{
+		return storeBack(oLeft, apply(oLeft, oRight, rightTmp, tmp), tmp);
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(pos);
+		throw;
+	}
+}
+
 UnaryNode::UnaryNode() = default;
-UnaryNode::~UnaryNode() { delete operand; }
+UnaryNode::~UnaryNode() = default;
+
+bool UnaryNode::isPure() const
+{
+	if (opType == OperatorType::PRE_INCR || opType == OperatorType::PRE_DECR ||
+		opType == OperatorType::POST_INCR || opType == OperatorType::POST_DECR)
+		return false;
+	return operand->isPure();
+}
 
 UnaryNode::UnaryNode(ASTNode* operand, const OperatorType opType,
                      size_t position) : opType(opType), operand(operand)
 {
 	pos = position;
+	if (opType == OperatorType::PRE_INCR || opType == OperatorType::PRE_DECR ||
+		opType == OperatorType::POST_INCR || opType == OperatorType::POST_DECR)
+		operand->setWritten();
 }
 
-Object* UnaryNode::eval(Scope* scope, bool)
+template <OperatorType op>
+static Object* applyUnary(Object* obj, Object& tmp)
 {
-	Object* obj = operand->eval(scope); // Get the single operand
-	Object* result = nullptr;
+	if constexpr (op == OperatorType::NOT) tmp.data = (!*obj).data;
+	else if constexpr (op == OperatorType::UNARY_NEGATION) tmp.data = (-*obj).data;
+	else if constexpr (op == OperatorType::UNARY_PLUS) tmp.data = (+*obj).data;
+	// The prefix operators return an lVal
+	else if constexpr (op == OperatorType::PRE_INCR) return &checkLval(++ *obj);
+	else if constexpr (op == OperatorType::PRE_DECR) return &checkLval(-- *obj);
+	else if constexpr (op == OperatorType::POST_INCR)
+	{
+		checkLval(*obj);
+		// The postfix do not. Hence, the old value is stored in tmp to act as an rval
+		tmp.data = ((*obj)++).data;
+	}
+	else if constexpr (op == OperatorType::POST_DECR)
+	{
+		checkLval(*obj);
+		tmp.data = ((*obj)--).data;
+	}
+	return &tmp;
+}
+
+UnaryOperator unaryOperator(const OperatorType opType)
+{
+	switch (opType)
+	{
+	case OperatorType::NOT: return &applyUnary<OperatorType::NOT>;
+	case OperatorType::UNARY_NEGATION: return &applyUnary<OperatorType::UNARY_NEGATION>;
+	case OperatorType::UNARY_PLUS: return &applyUnary<OperatorType::UNARY_PLUS>;
+	case OperatorType::PRE_INCR: return &applyUnary<OperatorType::PRE_INCR>;
+	case OperatorType::PRE_DECR: return &applyUnary<OperatorType::PRE_DECR>;
+	case OperatorType::POST_INCR: return &applyUnary<OperatorType::POST_INCR>;
+	case OperatorType::POST_DECR: return &applyUnary<OperatorType::POST_DECR>;
+	default: return nullptr;
+	}
+}
+
+Object* UnaryNode::eval(Scope* scope, Object& tmp, bool)
+{
+	Object operandTmp;
+	Object* obj = operand->eval(scope, operandTmp); // Get the single operand
 	if (!obj) { throw FatalError("", pos); } // Account for nullptr - fatal error
-	Object tmpObj;
 	try
 	{
-		switch (opType)
-		{
-		case OperatorType::NOT:
-			result = new Object(!*obj);
-			break;
-		case OperatorType::UNARY_NEGATION:
-			result = new Object(-*obj);
-			break;
-		case OperatorType::UNARY_PLUS:
-			result = new Object(+*obj);
-			break;
-		case OperatorType::PRE_INCR:
-			result = &checkLval(++ *obj); // The prefix operators return an lVal
-			break;
-		case OperatorType::PRE_DECR:
-			result = &checkLval(-- *obj);
-			break;
-		case OperatorType::POST_INCR:
-			checkLval(*obj);
-		// The postfix do not. Hence, we use a temporary object to act as an rval
-			tmpObj = (*obj)++;
-			result = new Object(tmpObj);
-			break;
-		case OperatorType::POST_DECR:
-			checkLval(*obj);
-			tmpObj = (*obj)--;
-			result = new Object(tmpObj);
-			break;
-		default:
-			throw FatalError("", pos);
-		}
+		const UnaryOperator op = unaryOperator(opType);
+		if (!op) throw FatalError("", pos);
+		return storeBack(obj, op(obj, tmp), tmp);
 	}
 	catch (CustomError& ce)
 	{
 		if (!ce.isPosSet()) ce.setPos(pos);
 		throw;
 	}
-
-	cleanTmps({obj}); // Clean tmp object
-	return result;
 }
 
 LiteralNode::LiteralNode() = default;
 
-LiteralNode::~LiteralNode()
+LiteralNode::~LiteralNode() = default; // The value belongs to the constant pool
+
+LiteralNode::LiteralNode(const Object* value, const size_t position) : literal(value)
 {
-	delete literal;
+	pos = position;
 }
 
-Object* LiteralNode::eval(Scope*, bool) { return new Object(*literal); }
+const Object& LiteralNode::getValue() const { return *literal; }
+bool LiteralNode::isPure() const { return true; }
+
+Object* LiteralNode::eval(Scope*, Object& tmp, bool)
+{
+	// Literals can't be modified, so a copy is returned. It shares the container of
+	// the value until it is changed
+	tmp = *literal;
+	return &tmp;
+}
 
 IDNode::IDNode() = default;
 IDNode::~IDNode() = default;
@@ -567,21 +919,252 @@ IDNode::IDNode(std::string id, size_t position) : id(std::move(id))
 	pos = position;
 }
 
-Object* IDNode::eval(Scope* scope, const bool lSide)
+const std::string& IDNode::getID() const { return id; }
+const Binding& IDNode::getBinding() const { return binding; }
+bool IDNode::isPure() const { return true; }
+
+Object* IDNode::eval(Scope* scope, Object& tmp, const bool lSide)
 {
-	Object* obj = nullptr;
-	if (!scope->checkObj(id) && lSide)
-		/* If object with set id doesn't exist, and is exactly in the left side (lSide)
-		 * of an equality operator, create a new object with such id*/
-		scope->addObj(Object(), id);
-	obj = scope->getObj(id);
+	/* If object with set id doesn't exist, and is exactly in the left side (lSide)
+	 * of an equality operator, create a new object with such id*/
+	Object* obj = (lSide)
+		              ? (scope->getOrAddObj(binding, id))
+		              : (scope->getObj(binding, id));
 	if (!obj)
 	{
 		throw NameError( // Throw error about inexistent variable
 			"Object with identifier \'" + id + "\' does not exist in scope.",
 			pos);
 	}
-	if (forceRval) // If it is forced to be an rval
-		obj->setLval(false);
+	if (forceRval) // If it is forced to be an rval, return a temporary copy
+	{
+		tmp = *obj;
+		return &tmp;
+	}
 	return obj;
 }
+
+HoistedNode::HoistedNode() = default;
+HoistedNode::~HoistedNode() = default;
+
+HoistedNode::HoistedNode(ASTNode* expr) : expr(expr)
+{
+	pos = expr->getPos();
+}
+
+Object* HoistedNode::eval(Scope* scope, Object&, bool)
+{
+	if (!evaluated)
+	{
+		Object tmp;
+		const Object* result = expr->eval(scope, tmp);
+		if (!result) return nullptr;
+		value.data = result->data; // A container is shared, not copied
+		evaluated = true;
+	}
+	return &value;
+}
+
+bool HoistedNode::isPure() const { return true; }
+
+void HoistedNode::reset()
+{
+	evaluated = false;
+	value.data = VariantType(); // Containers aren't kept shared after the loop
+}
+
+HoistedNode::LoopGuard::LoopGuard(const std::vector<HoistedNode*>& hoisted) :
+	hoisted(hoisted)
+{
+	for (HoistedNode* node : hoisted) node->reset();
+}
+
+HoistedNode::LoopGuard::~LoopGuard()
+{
+	for (HoistedNode* node : hoisted) node->reset();
+}
+
+FusedNode::FusedNode() = default;
+FusedNode::~FusedNode() = default;
+
+FusedNode::FusedNode(ASTNode* original) : original(original)
+{
+	pos = original->getPos();
+}
+
+IncrementNode::IncrementNode() = default;
+IncrementNode::~IncrementNode() = default;
+
+IncrementNode::IncrementNode(ASTNode* original, ASTNode* target, const int delta,
+                             const bool isPostfix, const bool isAssignment) :
+	FusedNode(original), target(target), delta(delta), isPostfix(isPostfix),
+	isAssignment(isAssignment)
+{
+}
+
+Object* IncrementNode::eval(Scope* scope, Object& tmp, const bool lSide)
+{
+	// The target is a variable, so it isn't stored in tmp
+	Object* obj = target->eval(scope, tmp, isAssignment);
+	int* x = std::get_if<int>(&obj->data);
+	if (!x || !obj->isLval() || obj->isConst()) return original->eval(scope, tmp, lSide);
+	if (isPostfix)
+	{
+		tmp.data = *x; // The old value, as an rval
+		*x = static_cast<int>(*x + delta);
+		return &tmp;
+	}
+	*x = static_cast<int>(*x + delta);
+	return obj;
+}
+
+StoreNode::StoreNode() = default;
+StoreNode::~StoreNode() = default;
+
+StoreNode::StoreNode(ASTNode* original, const nAryNode* subscript, ASTNode* array,
+                     std::vector<ASTNode*> indices, ASTNode* value,
+                     const size_t position) :
+	FusedNode(original), subscript(subscript), array(array), indices(std::move(indices)),
+	value(value)
+{
+	pos = position;
+}
+
+Object* StoreNode::eval(Scope* scope, Object& tmp, const bool lSide)
+{
+	const ArgStack::Frame operands(indices.size());
+	for (size_t i = 0; i != indices.size(); i++)
+	{
+		operands.arg(i) = indices[i]->eval(scope, operands.tmp(i));
+	}
+	const Args idxObjs = operands.getArgs();
+	/* An element of a packed array is stored directly, instead of through a proxy. The
+	 * value has no side effects, so the array doesn't change while it's evaluated. Any
+	 * other element is found like in the original tree. */
+	ArrayContainer* packed = nullptr;
+	size_t offset = ArrayContainer::npos;
+	Object* element = nullptr;
+	try
+	{
+		Object* arrObj = array->eval(scope, tmp); // A variable, it isn't stored in tmp
+		if (std::holds_alternative<Ref<ArrayContainer>>(arrObj->data))
+		{
+			arrObj->prepareWrite(); // Like in Object::getWritable()
+			packed = std::get<Ref<ArrayContainer>>(arrObj->data).get();
+			offset = packed->getOffset(idxObjs);
+		}
+		if (offset == ArrayContainer::npos) element = subscript->subscript(arrObj, idxObjs, tmp);
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(subscript->getPos());
+		throw;
+	}
+	try
+	{
+		Object* valueObj = value->eval(scope, tmp, lSide);
+		if (!valueObj) { throw FatalError("", pos); }
+		if (!element)
+		{
+			packed->store(offset, *valueObj);
+			if (valueObj != &tmp) tmp = *valueObj;
+			return &tmp; // The result is a copy of the element, like with a proxy
+		}
+		return storeBack(element, &checkLval(*element = *valueObj), tmp);
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(pos);
+		throw;
+	}
+}
+
+LeafBinaryNode::LeafBinaryNode() = default;
+LeafBinaryNode::~LeafBinaryNode() = default;
+
+LeafBinaryNode::LeafBinaryNode(ASTNode* original, ASTNode* left, ASTNode* right,
+                               const OperatorType opType, const size_t position) :
+	FusedNode(original), op(numericalOperator(opType)), left(left), right(right)
+{
+	pos = position;
+	// The values of literals are read only by the operators
+	if (const auto* literal = dynamic_cast<LiteralNode*>(left))
+		leftValue = const_cast<Object*>(&literal->getValue());
+	if (const auto* literal = dynamic_cast<LiteralNode*>(right))
+		rightValue = const_cast<Object*>(&literal->getValue());
+}
+
+bool LeafBinaryNode::isPure() const { return true; }
+
+Object* LeafBinaryNode::operand(ASTNode* node, Object* value, Scope* scope, Object& tmp,
+                                const bool lSide) const
+{
+	if (value) return value;
+	// A variable or a hoisted expression, it isn't stored in tmp
+	Object* result = node->eval(scope, tmp, lSide);
+	if (!result) { throw FatalError("", pos); }
+	return result;
+}
+
+Object* LeafBinaryNode::eval(Scope* scope, Object& tmp, const bool lSide)
+{
+	Object* oLeft = operand(left, leftValue, scope, tmp, false);
+	Object* oRight = operand(right, rightValue, scope, tmp, lSide);
+	try
+	{
+		return op(oLeft, oRight, tmp, tmp);
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(pos);
+		throw;
+	}
+}
+
+MethodCallNode::MethodCallNode() = default;
+MethodCallNode::~MethodCallNode() = default;
+
+MethodCallNode::MethodCallNode(ASTNode* original, const BinaryNode* member,
+                               ASTNode* receiver, std::vector<ASTNode*> args,
+                               const bool negated, const size_t position) :
+	FusedNode(original), member(member), receiver(receiver), args(std::move(args)),
+	negated(negated)
+{
+	pos = position;
+}
+
+bool MethodCallNode::isCall() const { return !negated; }
+
+Object* MethodCallNode::eval(Scope* scope, Object& tmp, bool)
+{
+	const ArgStack::Frame operands(args.size());
+	for (size_t i = 0; i != args.size(); i++)
+	{
+		operands.arg(i) = args[i]->eval(scope, operands.tmp(i));
+	}
+	const Args argObjs = operands.getArgs();
+	Object* result = nullptr;
+	try
+	{
+		Object* obj = receiver->eval(scope, tmp); // A variable, it isn't stored in tmp
+		if (obj->data.index() != cachedType)
+		{
+			cachedMethod = member->resolveMethod(*obj);
+			cachedType = obj->data.index();
+		}
+		result = takeResult(cachedMethod(*obj, argObjs), tmp);
+		for (auto arg = argObjs.rbegin(); arg != argObjs.rend(); ++arg)
+		{
+			if (*arg) (*arg)->storeBack();
+		}
+	}
+	catch (CustomError& ce)
+	{
+		if (!ce.isPosSet()) ce.setPos(pos);
+		throw;
+	}
+	if (!negated) return result;
+	if (!result) { throw FatalError("", original->getPos()); }
+	tmp.data = !result->isTrue();
+	return &tmp;
+}
@@ -0,0 +1,64 @@
+/* arena.cpp */
+
+#include "arena.h"
+#include <cstdint>
+
+Arena::Arena() = default;
+
+Arena::Arena(Arena&& arena2) noexcept :
+	chunks(std::move(arena2.chunks)), curr(arena2.curr), end(arena2.end),
+	dtors(std::move(arena2.dtors))
+{
+	arena2.curr = arena2.end = nullptr;
+}
+
+Arena& Arena::operator=(Arena&& arena2) noexcept
+{
+	if (this != &arena2)
+	{
+		release();
+		chunks = std::move(arena2.chunks);
+		dtors = std::move(arena2.dtors);
+		curr = arena2.curr;
+		end = arena2.end;
+		arena2.curr = arena2.end = nullptr;
+	}
+	return *this;
+}
+
+Arena::~Arena()
+{
+	release();
+}
+
+static std::byte* alignUp(std::byte* ptr, const size_t align)
+{ // Rounds the pointer up to the alignment (a power of 2)
+	const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+	return reinterpret_cast<std::byte*>((addr + align - 1) & ~(align - 1));
+}
+
+void* Arena::allocate(const size_t size, const size_t align)
+{
+	std::byte* ptr = alignUp(curr, align);
+	if (!curr || ptr + size > end)
+	{ // Doesn't fit, start a new chunk. Big objects get a chunk of their own
+		const size_t chunkSize = (size + align > CHUNK_SIZE) ? (size + align) : (CHUNK_SIZE);
+		chunks.emplace_back(new std::byte[chunkSize]); // Left uninitialized
+		curr = chunks.back().get();
+		end = curr + chunkSize;
+		ptr = alignUp(curr, align);
+	}
+	curr = ptr + size;
+	return ptr;
+}
+
+void Arena::release()
+{
+	for (auto itr = dtors.rbegin(); itr != dtors.rend(); ++itr)
+	{
+		itr->destroy(itr->obj);
+	}
+	dtors.clear();
+	chunks.clear();
+	curr = end = nullptr;
+}
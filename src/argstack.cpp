@@ -0,0 +1,43 @@
+/* argstack.cpp */
+
+#include "argstack.h"
+#include <algorithm>
+
+thread_local std::vector<ArgStack::Chunk> ArgStack::chunks;
+thread_local size_t ArgStack::curr = 0;
+
+ArgStack::Chunk::Chunk(const size_t capacity) :
+	args(new Object*[capacity]), tmps(new Object[capacity]), capacity(capacity)
+{
+}
+
+ArgStack::Frame::Frame(const size_t n) : n(n)
+{
+	if (chunks.empty()) chunks.emplace_back(CHUNK_SIZE);
+	if (chunks[curr].used + n > chunks[curr].capacity)
+	{
+		// The frame goes in the next chunk, which is unused. One that is too small is
+		// replaced
+		curr++;
+		if (curr == chunks.size()) chunks.emplace_back(std::max(n, CHUNK_SIZE));
+		else if (chunks[curr].capacity < n) chunks[curr] = Chunk(n);
+	}
+	Chunk& top = chunks[curr];
+	chunk = curr;
+	start = top.used;
+	args = top.args.get() + start;
+	tmps = top.tmps.get() + start;
+	top.used += n;
+}
+
+ArgStack::Frame::~Frame()
+{
+	for (size_t i = 0; i != n; i++)
+	{
+		// The temporaries are reset for the next frame, like new objects
+		std::destroy_at(tmps + i);
+		std::construct_at(tmps + i);
+	}
+	curr = chunk; // Frames above this one are freed already
+	chunks[curr].used = start;
+}
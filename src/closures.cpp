@@ -0,0 +1,400 @@
+/* closures.cpp */
+
+#include "closure.h"
+#include "AST.h"
+#include "argstack.h"
+#include "errors.h"
+
+/* Each node makes its closure out of the closures of its children, which it captures
+ * by value. The closures do what the eval() of their node does (see AST.cpp), in the
+ * same order, so that side effects and errors happen exactly as in the tree-walker. */
+
+ClosureCompiler::ClosureCompiler() = default;
+
+StmtClosure ClosureCompiler::compile(CodeBlock* mainBlock)
+{
+	return mainBlock->close(*this);
+}
+
+const StmtClosure* ClosureCompiler::addBody(StmtClosure body)
+{
+	return &bodies.emplace_back(std::move(body));
+}
+
+StmtClosure CodeBlock::close(ClosureCompiler& compiler)
+{
+	std::vector<StmtClosure> statements;
+	statements.reserve(statementVec.size());
+	for (Statement* st : statementVec)
+	{
+		statements.push_back(st->close(compiler));
+	}
+	return [statements = std::move(statements), nSlots = nSlots](
+		Scope* scope, const bool isInFunction) -> Object*
+	{
+		Object* tmpObj = nullptr;
+		scope->incLevel(nSlots);
+		const size_t writeMark = WriteLocks::mark();
+		for (const StmtClosure& st : statements)
+		{
+			tmpObj = st(scope, isInFunction);
+			WriteLocks::release(writeMark); // The containers it changed
+			// A statement that returns something is a return statement
+			if (tmpObj != nullptr) break;
+		}
+		scope->decrLevel();
+		return tmpObj;
+	};
+}
+
+StmtClosure Statement::close(ClosureCompiler&)
+{
+	return [](Scope*, bool) -> Object* { return nullptr; };
+}
+
+StmtClosure IfStatement::close(ClosureCompiler& compiler)
+{
+	std::vector<std::pair<ExprClosure, StmtClosure>> closedCases;
+	for (const auto& [casePtr, blockPtr] : cases)
+	{
+		closedCases.emplace_back(casePtr->close(compiler), blockPtr->close(compiler));
+	}
+	return [closedCases = std::move(closedCases)](
+		Scope* scope, const bool isInFunction) -> Object*
+	{
+		for (const auto& [condition, block] : closedCases)
+		{
+			Object caseTmp;
+			if (condition(scope, caseTmp)->isTrue()) return block(scope, isInFunction);
+		}
+		return nullptr;
+	};
+}
+
+StmtClosure WhileStatement::close(ClosureCompiler& compiler)
+{
+	return [condition = condition->close(compiler), block = block->close(compiler),
+			hoisted = hoisted](Scope* scope, const bool isInFunction) -> Object*
+	{
+		const HoistedNode::LoopGuard guard(hoisted);
+		Object conditionTmp;
+		Object* tmpObj = nullptr;
+		const size_t writeMark = WriteLocks::mark();
+		while (true)
+		{
+			const bool isTrue = condition(scope, conditionTmp)->isTrue();
+			WriteLocks::release(writeMark);
+			if (!isTrue) break;
+			tmpObj = block(scope, isInFunction);
+			if (tmpObj != nullptr) break;
+		}
+		return tmpObj;
+	};
+}
+
+StmtClosure ForStatement::close(ClosureCompiler& compiler)
+{
+	return [counter = counterNode->close(compiler, true),
+			lower = lowerNode->close(compiler), upper = upperNode->close(compiler),
+			block = block->close(compiler), pos = pos, counted = counted,
+			hoisted = hoisted](Scope* scope, const bool isInFunction) -> Object*
+	{
+		const HoistedNode::LoopGuard guard(hoisted);
+		Object lowerTmp, upperTmp, counterTmp;
+		Object* lowerObj = lower(scope, lowerTmp);
+		Object* upperObj = upper(scope, upperTmp);
+		scope->incLevel(1); // The counter variable exists in an inner scope
+		Object* counterObj = counter(scope, counterTmp);
+		if ((*lowerObj > *upperObj).isTrue())
+			throw ValueError("Lower limit greater than upper limit.", pos);
+		*counterObj = *lowerObj;
+		Object* tmpObj = nullptr;
+		if (counted)
+		{
+			tmpObj = countedLoop(*counterObj, *upperObj,
+			                     [&] { return block(scope, isInFunction); });
+			scope->decrLevel();
+			return tmpObj;
+		}
+		while ((*counterObj <= *upperObj).isTrue())
+		{
+			tmpObj = block(scope, isInFunction);
+			if (tmpObj != nullptr) break;
+			lowerObj = lower(scope, lowerTmp); // Re-evaluate the limits
+			upperObj = upper(scope, upperTmp);
+			++(*counterObj);
+		}
+		scope->decrLevel();
+		return tmpObj;
+	};
+}
+
+StmtClosure ExprStatement::close(ClosureCompiler& compiler)
+{
+	return [expr = exprRoot->close(compiler)](Scope* scope, bool) -> Object*
+	{
+		Object tmp;
+		expr(scope, tmp); // The result is discarded
+		return nullptr;
+	};
+}
+
+StmtClosure ReturnStatement::close(ClosureCompiler& compiler)
+{
+	return [expr = returnRoot->close(compiler), pos = pos](
+		Scope* scope, const bool isInFunction) -> Object*
+	{
+		if (!isInFunction)
+		{
+			throw CustomError("Return statements should only be inside functions.",
+			                  pos);
+		}
+		Object tmp;
+		Object* returnObj = expr(scope, tmp);
+		if (!returnObj) throw FatalError("", pos);
+		const auto newObj = new Object; // Like ReturnStatement::eval
+		if (returnObj == &tmp || scope->isLocal(returnObj))
+			newObj->data = std::move(returnObj->data);
+		else *newObj = *returnObj;
+		return newObj;
+	};
+}
+
+StmtClosure FunctionDefStatement::close(ClosureCompiler& compiler)
+{
+	// The body is turned into a closure once, and shared by the functions defined here
+	const StmtClosure* body = compiler.addBody(block->close(compiler));
+	return [id = funcID->close(compiler, true), block = block, params = funcParams,
+			body](Scope* scope, bool) -> Object*
+	{
+		Object tmp;
+		*id(scope, tmp) = Object(
+			Function(block, params, scope->getFuncLevel(), nullptr, body));
+		return nullptr;
+	};
+}
+
+ExprClosure ASTNode::close(ClosureCompiler&, const bool lSide)
+{
+	return [this, lSide](Scope* scope, Object& tmp) { return eval(scope, tmp, lSide); };
+}
+
+CallClosure ASTNode::closeCall(ClosureCompiler& compiler)
+{
+	return [callee = close(compiler), pos = pos](Scope* scope, Object& calleeTmp,
+	                                             const Args args)
+	{
+		Object* func = callee(scope, calleeTmp);
+		if (!func) { throw FatalError("", pos); }
+		return (*func)(scope, args);
+	};
+}
+
+ExprClosure nAryNode::close(ClosureCompiler& compiler, bool)
+{
+	std::vector<ExprClosure> operands;
+	operands.reserve(nOperands.size());
+	for (ASTNode* node : nOperands)
+	{
+		operands.push_back(node->close(compiler));
+	}
+	switch (opType)
+	{
+	case OperatorType::SUBSCRIPT:
+		return [this, operands = std::move(operands),
+				main = mainOperand->close(compiler)](Scope* scope, Object& tmp)
+		{
+			const ArgStack::Frame indices(operands.size());
+			for (size_t i = 0; i != operands.size(); i++)
+			{
+				indices.arg(i) = operands[i](scope, indices.tmp(i));
+			}
+			try
+			{
+				Object mainTmp;
+				Object* mainObject = main(scope, mainTmp);
+				Object* result = subscript(mainObject, indices.getArgs(), tmp);
+				if (mainObject == &mainTmp && result != &tmp)
+				{ // An element of a temporary container must outlive it
+					tmp = *result;
+					result->storeBack();
+					result = &tmp;
+				}
+				return result;
+			}
+			catch (CustomError& ce)
+			{
+				if (!ce.isPosSet()) ce.setPos(pos);
+				throw;
+			}
+		};
+	case OperatorType::FUNCTION_CALL:
+		return [operands = std::move(operands), callee = mainOperand->closeCall(compiler),
+				pos = pos](Scope* scope, Object& tmp)
+		{
+			const ArgStack::Frame args(operands.size());
+			for (size_t i = 0; i != operands.size(); i++)
+			{
+				args.arg(i) = operands[i](scope, args.tmp(i));
+			}
+			try
+			{
+				Object calleeTmp;
+				Object* result = takeResult(callee(scope, calleeTmp, args.getArgs()), tmp);
+				// The arguments may have been changed, i.e. input(A[0])
+				for (size_t i = operands.size(); i-- != 0;)
+				{
+					if (args.arg(i)) args.arg(i)->storeBack();
+				}
+				return result;
+			}
+			catch (CustomError& ce)
+			{
+				if (!ce.isPosSet()) ce.setPos(pos);
+				throw;
+			}
+		};
+	case OperatorType::LIST_INIT:
+		return [operands = std::move(operands)](Scope* scope, Object& tmp)
+		{
+			const ArgStack::Frame elements(operands.size());
+			for (size_t i = 0; i != operands.size(); i++)
+			{
+				elements.arg(i) = operands[i](scope, elements.tmp(i));
+			}
+			tmp.data = makeRef<ArrayContainer>(elements.getArgs());
+			return &tmp;
+		};
+	default:
+		return [](Scope*, Object&) -> Object* { return nullptr; };
+	}
+}
+
+ExprClosure BinaryNode::close(ClosureCompiler& compiler, const bool lSide)
+{
+	if (opType == OperatorType::MEMBER_ACCESS)
+	{ // A method as a value, bound to the receiver's container
+		return [this, receiver = left->close(compiler)](Scope* scope, Object& tmp)
+		{
+			Object leftTmp;
+			Object* oLeft = receiver(scope, leftTmp);
+			if (!oLeft) { throw FatalError("", pos); }
+			try
+			{
+				tmp = Object(bindMethod(*oLeft, resolveMethod(*oLeft)));
+			}
+			catch (CustomError& ce)
+			{
+				if (!ce.isPosSet()) ce.setPos(pos);
+				throw;
+			}
+			return &tmp;
+		};
+	}
+	const BinaryOperator op = numericalOperator(opType);
+	if (!op)
+	{
+		return [pos = pos](Scope*, Object&) -> Object* { throw FatalError("", pos); };
+	}
+	// The left node of an assignment may create the variable
+	return [l = left->close(compiler, opType == OperatorType::ASSIGNMENT),
+			r = right->close(compiler, lSide), op, pos = pos](Scope* scope, Object& tmp)
+	{
+		Object leftTmp; // Hold the operands if they are temporary
+		Object* oLeft = l(scope, leftTmp);
+		if (!oLeft) { throw FatalError("", pos); }
+		try
+		{
+			Object rightTmp;
+			Object* oRight = r(scope, rightTmp);
+			if (!oRight) { throw FatalError("", pos); }
+			return storeBack(oLeft, op(oLeft, oRight, rightTmp, tmp), tmp);
+		}
+		catch (CustomError& ce)
+		{
+			if (!ce.isPosSet()) ce.setPos(pos);
+			throw;
+		}
+	};
+}
+
+CallClosure BinaryNode::closeCall(ClosureCompiler& compiler)
+{
+	if (opType != OperatorType::MEMBER_ACCESS) return ASTNode::closeCall(compiler);
+	// A method call, with its own inline cache (see BinaryNode::call)
+	return [this, receiver = left->close(compiler), cachedType = std::variant_npos,
+			cachedMethod = static_cast<Method>(nullptr)](
+		Scope* scope, Object& calleeTmp, const Args args) mutable
+	{
+		Object* obj = receiver(scope, calleeTmp);
+		if (!obj) { throw FatalError("", pos); }
+		if (obj->data.index() != cachedType)
+		{
+			cachedMethod = resolveMethod(*obj);
+			cachedType = obj->data.index();
+		}
+		return cachedMethod(*obj, args);
+	};
+}
+
+ExprClosure UnaryNode::close(ClosureCompiler& compiler, bool)
+{
+	const UnaryOperator op = unaryOperator(opType);
+	if (!op)
+	{
+		return [pos = pos](Scope*, Object&) -> Object* { throw FatalError("", pos); };
+	}
+	return [operand = operand->close(compiler), op, pos = pos](Scope* scope, Object& tmp)
+	{
+		Object operandTmp;
+		Object* obj = operand(scope, operandTmp);
+		if (!obj) { throw FatalError("", pos); }
+		try
+		{
+			return storeBack(obj, op(obj, tmp), tmp);
+		}
+		catch (CustomError& ce)
+		{
+			if (!ce.isPosSet()) ce.setPos(pos);
+			throw;
+		}
+	};
+}
+
+ExprClosure LiteralNode::close(ClosureCompiler&, bool)
+{
+	return [value = literal](Scope*, Object& tmp)
+	{
+		tmp = *value; // Shares the container of the value, like eval()
+		return &tmp;
+	};
+}
+
+// A variable, found in the slots of its binding (or created in them, on the left side)
+template <bool lSide, bool forceRval>
+static ExprClosure closeID(const IDNode* node)
+{
+	return [node](Scope* scope, [[maybe_unused]] Object& tmp)
+	{
+		Object* obj = nullptr;
+		if constexpr (lSide) obj = scope->getOrAddObj(node->getBinding(), node->getID());
+		else obj = scope->getObj(node->getBinding(), node->getID());
+		if (!obj)
+		{
+			throw NameError("Object with identifier \'" + node->getID() +
+			                "\' does not exist in scope.", node->getPos());
+		}
+		if constexpr (forceRval) // A temporary copy
+		{
+			tmp = *obj;
+			return &tmp;
+		}
+		else return obj;
+	};
+}
+
+ExprClosure IDNode::close(ClosureCompiler&, const bool lSide)
+{
+	if (lSide) return (forceRval) ? (closeID<true, true>(this)) : (closeID<true, false>(this));
+	return (forceRval) ? (closeID<false, true>(this)) : (closeID<false, false>(this));
+}
@@ -0,0 +1,652 @@
+/* compiler.cpp */
+
+#include "bytecode.h"
+#include "AST.h"
+#include "errors.h"
+#include <iomanip>
+#include <sstream>
+
+/* The compiler lowers the AST to bytecode. Each node emits its own code, in the same
+ * order in which its eval() would evaluate it, so that side effects and errors happen
+ * exactly as in the tree-walker. Errors thrown by an instruction take the position of
+ * the node that emitted it, just like the catch blocks of the nodes. */
+
+Compiler::Compiler() = default;
+
+std::unique_ptr<Proto> Compiler::compile(const CodeBlock* mainBlock)
+{
+	auto mainProto = std::make_unique<Proto>();
+	mainProto->name = "<main>";
+	proto = mainProto.get();
+	freeReg = 0;
+	inFunction = false;
+	mainBlock->compile(*this);
+	emit(OpCode::HALT);
+	proto = nullptr;
+	return mainProto;
+}
+
+uint16_t Compiler::compileMethod(const std::string& name, CodeBlock* block,
+                                 const std::vector<ASTNode*>& params)
+{
+	// The method is compiled in a unit of its own, with a fresh register window
+	auto methodProto = std::make_unique<Proto>();
+	methodProto->name = name;
+	methodProto->block = block;
+	methodProto->params = params;
+
+	Proto* outerProto = proto; // Save the state of the enclosing unit
+	const int outerFreeReg = freeReg;
+	const bool outerInFunction = inFunction;
+	proto = methodProto.get();
+	freeReg = 0;
+	inFunction = true; // Return statements are now valid
+	block->compile(*this);
+	emit(OpCode::HALT); // Falling off the end returns nothing
+	proto = outerProto;
+	freeReg = outerFreeReg;
+	inFunction = outerInFunction;
+
+	if (proto->protos.size() > UINT16_MAX)
+		throw FatalError("Too many methods to compile.");
+	proto->protos.push_back(std::move(methodProto));
+	return static_cast<uint16_t>(proto->protos.size() - 1);
+}
+
+size_t Compiler::emit(const OpCode op, const int a, const uint32_t b,
+                      const uint32_t c, const size_t pos)
+{
+	if (a > UINT16_MAX || b > UINT16_MAX)
+		throw FatalError("Program too large to compile.");
+	// The instructions that may change a container lock it (see WriteLocks)
+	if (op == OpCode::CALL || op == OpCode::CALL_METHOD ||
+		op == OpCode::SUBSCRIPT_CHAIN || (op == OpCode::SUBSCRIPT && b))
+		locksTaken = true;
+	proto->code.push_back({op, static_cast<uint16_t>(a),
+	                       static_cast<uint16_t>(b), c});
+	proto->positions.push_back(pos);
+	return proto->code.size() - 1;
+}
+
+void Compiler::patch(const size_t at, const size_t target)
+{
+	proto->code[at].c = static_cast<uint32_t>(target);
+}
+
+size_t Compiler::here() const { return proto->code.size(); }
+
+// The index of the entry last added to a pool of a unit, which is an operand b
+static uint16_t lastIndex(const size_t poolSize)
+{
+	if (poolSize > UINT16_MAX + 1) throw FatalError("Program too large to compile.");
+	return static_cast<uint16_t>(poolSize - 1);
+}
+
+uint16_t Compiler::addConstant(const Object& obj)
+{
+	proto->constants.push_back(obj);
+	return lastIndex(proto->constants.size());
+}
+
+uint16_t Compiler::addID(const IDNode* idNode)
+{
+	proto->ids.push_back(idNode);
+	return lastIndex(proto->ids.size());
+}
+
+uint16_t Compiler::addSubscript(const nAryNode* node)
+{
+	proto->subscripts.push_back(node);
+	return lastIndex(proto->subscripts.size());
+}
+
+uint16_t Compiler::addName(const std::string& name)
+{
+	// Names are interned, each one is stored once per unit
+	for (size_t i = 0; i != proto->names.size(); i++)
+	{
+		if (proto->names[i] == name) return static_cast<uint16_t>(i);
+	}
+	proto->names.push_back(name);
+	return lastIndex(proto->names.size());
+}
+
+uint16_t Compiler::addMethodCall(const std::string& name, const size_t pos,
+                                 const size_t namePos)
+{
+	// Every call site gets its own entry, as each one caches its own method
+	proto->methodCalls.push_back({name, pos, namePos});
+	return lastIndex(proto->methodCalls.size());
+}
+
+int Compiler::reserve(const int n, const size_t pos)
+{
+	const int first = freeReg;
+	freeReg += n;
+	if (freeReg > UINT16_MAX) // Registers are addressed with 16 bits
+		throw FatalError("Expression too complex to compile.", pos);
+	if (freeReg > proto->nRegs) proto->nRegs = freeReg;
+	return first;
+}
+
+void Compiler::release(const int reg) { freeReg = reg; }
+void Compiler::beginStatement() { locksTaken = false; }
+
+void Compiler::endStatement()
+{
+	if (locksTaken) emit(OpCode::RELEASE_LOCKS);
+	locksTaken = false;
+}
+
+int Compiler::getFreeReg() const { return freeReg; }
+bool Compiler::isInFunction() const { return inFunction; }
+
+void CodeBlock::compile(Compiler& compiler) const
+{
+	compiler.emit(OpCode::ENTER_BLOCK, 0, getSlotCount()); // Same as CodeBlock::eval
+	for (const Statement* st : statementVec)
+	{
+		compiler.beginStatement();
+		st->compile(compiler);
+		compiler.endStatement();
+	}
+	compiler.emit(OpCode::EXIT_BLOCK);
+}
+
+void Statement::compile(Compiler&) const
+{
+}
+
+void IfStatement::compile(Compiler& compiler) const
+{
+	std::vector<size_t> exitJumps; // Jumps to the end of the chain
+	for (size_t i = 0; i != cases.size(); i++)
+	{
+		const auto& [casePtr, blockPtr] = cases[i];
+		const int reg = compiler.reserve(1, pos);
+		casePtr->compile(compiler, reg);
+		// Skip the block if the condition is false
+		const size_t skip = compiler.emit(OpCode::JUMP_IF_FALSE, reg);
+		compiler.release(reg);
+		blockPtr->compile(compiler);
+		if (i + 1 != cases.size()) exitJumps.push_back(
+			compiler.emit(OpCode::JUMP));
+		compiler.patch(skip, compiler.here());
+	}
+	for (const size_t jump : exitJumps)
+	{
+		compiler.patch(jump, compiler.here());
+	}
+}
+
+void WhileStatement::compile(Compiler& compiler) const
+{
+	const size_t start = compiler.here();
+	const int reg = compiler.reserve(1, pos);
+	condition->compile(compiler, reg);
+	const size_t exit = compiler.emit(OpCode::JUMP_IF_FALSE, reg);
+	compiler.release(reg);
+	compiler.endStatement(); // The locks of the condition, the block takes its own
+	block->compile(compiler);
+	compiler.emit(OpCode::JUMP, 0, 0, static_cast<uint32_t>(start));
+	compiler.patch(exit, compiler.here());
+}
+
+void ForStatement::compile(Compiler& compiler) const
+{
+	// The counter and the limits stay in registers for the whole loop
+	const int counter = compiler.reserve(3, pos);
+	const int lower = counter + 1, upper = counter + 2;
+	lowerNode->compile(compiler, lower);
+	upperNode->compile(compiler, upper);
+	compiler.emit(OpCode::ENTER_BLOCK, 0, 1); // The counter lives in an inner scope
+	counterNode->compile(compiler, counter, true);
+	compiler.emit(OpCode::FOR_CHECK, lower, upper, static_cast<uint32_t>(pos));
+	compiler.emit(OpCode::SET, counter, lower);
+
+	const size_t start = compiler.here();
+	const int cond = compiler.reserve(1, pos);
+	compiler.emit(OpCode::LESS_EQ, cond, counter, upper);
+	const size_t exit = compiler.emit(OpCode::JUMP_IF_FALSE, cond);
+	compiler.release(cond);
+	const size_t body = compiler.here();
+	block->compile(compiler);
+	if (counted) // The limits can't change, so a single instruction goes on to the next
+		compiler.emit(OpCode::FOR_LOOP, counter, upper, static_cast<uint32_t>(body));
+	else // The limits are evaluated again, as something may have changed
+	{
+		lowerNode->compile(compiler, lower);
+		upperNode->compile(compiler, upper);
+		compiler.emit(OpCode::INCR, counter);
+		compiler.emit(OpCode::JUMP, 0, 0, static_cast<uint32_t>(start));
+	}
+	compiler.patch(exit, compiler.here());
+	compiler.emit(OpCode::EXIT_BLOCK);
+	compiler.release(counter);
+}
+
+void ExprStatement::compile(Compiler& compiler) const
+{
+	const int reg = compiler.reserve(1, pos);
+	exprRoot->compile(compiler, reg); // The result is discarded
+	compiler.release(reg);
+}
+
+void ReturnStatement::compile(Compiler& compiler) const
+{
+	if (!compiler.isInFunction())
+	{
+		// The error is only raised if the statement is actually executed
+		compiler.emit(OpCode::RETURN_ERROR, 0, 0, 0, pos);
+		return;
+	}
+	const int reg = compiler.reserve(1, pos);
+	returnRoot->compile(compiler, reg);
+	compiler.emit(OpCode::RETURN, reg);
+	compiler.release(reg);
+}
+
+void FunctionDefStatement::compile(Compiler& compiler) const
+{
+	const int reg = compiler.reserve(2, pos);
+	funcID->compile(compiler, reg, true);
+	const auto* idNode = dynamic_cast<const IDNode*>(funcID);
+	const uint16_t unit = compiler.compileMethod(
+		idNode ? idNode->getID() : "<method>", block, funcParams);
+	compiler.emit(OpCode::FUNCTION, reg + 1, unit);
+	compiler.emit(OpCode::SET, reg, reg + 1);
+	compiler.release(reg);
+}
+
+void ASTNode::compile(Compiler&, int, bool) const
+{
+}
+
+void ASTNode::compileCall(Compiler& compiler, const int base, const uint32_t nArgs,
+                          const size_t callPos) const
+{
+	compile(compiler, base);
+	compiler.emit(OpCode::CALL, base, 0, nArgs, callPos);
+}
+
+void nAryNode::compile(Compiler& compiler, const int dst, bool) const
+{
+	// The operands go right after the main operand. If dst is the last register in
+	// use they can follow it directly, else the result is moved to dst at the end
+	const int base = (compiler.getFreeReg() == dst + 1)
+		                 ? dst
+		                 : compiler.reserve(1, pos);
+	compiler.reserve(static_cast<int>(nOperands.size()), pos);
+	for (size_t i = 0; i != nOperands.size(); i++)
+	{
+		nOperands[i]->compile(compiler, base + 1 + static_cast<int>(i));
+	}
+	const auto nArgs = static_cast<uint32_t>(nOperands.size());
+	switch (opType)
+	{
+	case OperatorType::SUBSCRIPT:
+		mainOperand->compile(compiler, base);
+		if (chain.size() > 1) // The operator knows how to apply the chain
+			compiler.emit(OpCode::SUBSCRIPT_CHAIN, base, compiler.addSubscript(this),
+			              nArgs, pos);
+		else compiler.emit(OpCode::SUBSCRIPT, base, written, nArgs, pos);
+		break;
+	case OperatorType::FUNCTION_CALL:
+		mainOperand->compileCall(compiler, base, nArgs, pos);
+		break;
+	case OperatorType::LIST_INIT:
+		compiler.emit(OpCode::LIST, base, 0, nArgs, pos);
+		break;
+	default:
+		break;
+	}
+	if (base != dst)
+	{
+		compiler.emit(OpCode::MOVE, dst, static_cast<uint32_t>(base));
+		compiler.release(base);
+	}
+	else compiler.release(base + 1);
+}
+
+void BinaryNode::compileCall(Compiler& compiler, const int base, const uint32_t nArgs,
+                             const size_t callPos) const
+{
+	const auto* method = dynamic_cast<const IDNode*>(right);
+	if (opType != OperatorType::MEMBER_ACCESS || !method)
+	{
+		ASTNode::compileCall(compiler, base, nArgs, callPos);
+		return;
+	}
+	// The receiver goes in place of the callee, the method is found when called
+	left->compile(compiler, base);
+	compiler.emit(OpCode::CALL_METHOD, base,
+	              compiler.addMethodCall(method->getID(), pos, method->getPos()),
+	              nArgs, callPos);
+}
+
+// Maps the operators of binary nodes to their instructions
+static OpCode binaryOpCode(const OperatorType opType, const size_t pos)
+{
+	switch (opType)
+	{
+	case OperatorType::ADDITION: return OpCode::ADD;
+	case OperatorType::SUBTRACTION: return OpCode::SUB;
+	case OperatorType::MULTIPLICATION: return OpCode::MUL;
+	case OperatorType::DIVISION: return OpCode::DIV;
+	case OperatorType::MODULO: return OpCode::MOD;
+	case OperatorType::DIV: return OpCode::INT_DIV;
+	case OperatorType::LESS: return OpCode::LESS;
+	case OperatorType::LESS_EQ: return OpCode::LESS_EQ;
+	case OperatorType::GREATER: return OpCode::GREATER;
+	case OperatorType::GRE_EQ: return OpCode::GRE_EQ;
+	case OperatorType::EQUAL: return OpCode::EQUAL;
+	case OperatorType::NOT_EQUAL: return OpCode::NOT_EQUAL;
+	case OperatorType::OR: return OpCode::OR;
+	case OperatorType::AND: return OpCode::AND;
+	case OperatorType::ASSIGNMENT: return OpCode::ASSIGN;
+	case OperatorType::ADDITION_ASSIGN: return OpCode::ADD_ASSIGN;
+	case OperatorType::SUBTRACTION_ASSIGN: return OpCode::SUB_ASSIGN;
+	case OperatorType::MULTIPLICATION_ASSIGN: return OpCode::MUL_ASSIGN;
+	case OperatorType::DIVISION_ASSIGN: return OpCode::DIV_ASSIGN;
+	case OperatorType::MODULO_ASSIGN: return OpCode::MOD_ASSIGN;
+	case OperatorType::DIV_ASSIGN: return OpCode::INT_DIV_ASSIGN;
+	case OperatorType::COMMA: return OpCode::SELECT;
+	default: throw FatalError("", pos);
+	}
+}
+
+void BinaryNode::compile(Compiler& compiler, const int dst,
+                         const bool lSide) const
+{
+	if (opType == OperatorType::MEMBER_ACCESS)
+	{
+		// The method is looked up in the methods of the object's type, by name
+		left->compile(compiler, dst);
+		const auto* method = dynamic_cast<const IDNode*>(right);
+		if (!method) throw ParsingError("Method name expected.", pos);
+		compiler.emit(OpCode::GET_METHOD, dst,
+		              compiler.addName(method->getID()),
+		              static_cast<uint32_t>(method->getPos()), pos);
+		return;
+	}
+	// Allow new variable initialization, just like in eval()
+	left->compile(compiler, dst, opType == OperatorType::ASSIGNMENT);
+	if (left->isCall()) // A method like push() returns nothing
+		compiler.emit(OpCode::NOT_VOID, dst, 0, 0, pos);
+	const int rReg = compiler.reserve(1, pos);
+	right->compile(compiler, rReg, lSide);
+	if (opType == OperatorType::COMMA)
+		compiler.emit(OpCode::SELECT, dst, static_cast<uint32_t>(rReg), 0, pos);
+	else
+		compiler.emit(binaryOpCode(opType, pos), dst,
+		              static_cast<uint32_t>(dst), static_cast<uint32_t>(rReg),
+		              pos);
+	compiler.release(rReg);
+}
+
+void UnaryNode::compile(Compiler& compiler, const int dst, bool) const
+{
+	OpCode op;
+	switch (opType)
+	{
+	case OperatorType::NOT: op = OpCode::NOT;
+		break;
+	case OperatorType::UNARY_NEGATION: op = OpCode::NEGATE;
+		break;
+	case OperatorType::UNARY_PLUS: op = OpCode::PLUS;
+		break;
+	case OperatorType::PRE_INCR: op = OpCode::PRE_INCR;
+		break;
+	case OperatorType::PRE_DECR: op = OpCode::PRE_DECR;
+		break;
+	case OperatorType::POST_INCR: op = OpCode::POST_INCR;
+		break;
+	case OperatorType::POST_DECR: op = OpCode::POST_DECR;
+		break;
+	default:
+		throw FatalError("", pos);
+	}
+	operand->compile(compiler, dst);
+	compiler.emit(op, dst, static_cast<uint32_t>(dst), 0, pos);
+}
+
+void LiteralNode::compile(Compiler& compiler, const int dst, bool) const
+{
+	compiler.emit(OpCode::LOAD_CONST, dst, compiler.addConstant(*literal), 0,
+	              pos);
+}
+
+void IDNode::compile(Compiler& compiler, const int dst, const bool lSide) const
+{
+	compiler.emit(lSide ? OpCode::DEF_NAME : OpCode::LOAD_NAME, dst,
+	              compiler.addID(this), 0, pos);
+	if (forceRval) // (myVar) is a copy, so it cannot be assigned to
+		compiler.emit(OpCode::COPY, dst, static_cast<uint32_t>(dst));
+}
+
+void HoistedNode::compile(Compiler& compiler, const int dst, const bool lSide) const
+{
+	expr->compile(compiler, dst, lSide); // Evaluated every time in the VM
+}
+
+void FusedNode::compile(Compiler& compiler, const int dst, const bool lSide) const
+{
+	original->compile(compiler, dst, lSide); // The VM has its own instructions
+}
+
+/* Disassembler */
+
+static const char* opCodeName(const OpCode op)
+{
+	switch (op)
+	{
+	case OpCode::LOAD_CONST: return "LOAD_CONST";
+	case OpCode::LOAD_NAME: return "LOAD_NAME";
+	case OpCode::DEF_NAME: return "DEF_NAME";
+	case OpCode::COPY: return "COPY";
+	case OpCode::MOVE: return "MOVE";
+	case OpCode::SELECT: return "SELECT";
+	case OpCode::NOT_VOID: return "NOT_VOID";
+	case OpCode::ADD: return "ADD";
+	case OpCode::SUB: return "SUB";
+	case OpCode::MUL: return "MUL";
+	case OpCode::DIV: return "DIV";
+	case OpCode::MOD: return "MOD";
+	case OpCode::INT_DIV: return "INT_DIV";
+	case OpCode::LESS: return "LESS";
+	case OpCode::LESS_EQ: return "LESS_EQ";
+	case OpCode::GREATER: return "GREATER";
+	case OpCode::GRE_EQ: return "GRE_EQ";
+	case OpCode::EQUAL: return "EQUAL";
+	case OpCode::NOT_EQUAL: return "NOT_EQUAL";
+	case OpCode::OR: return "OR";
+	case OpCode::AND: return "AND";
+	case OpCode::ASSIGN: return "ASSIGN";
+	case OpCode::ADD_ASSIGN: return "ADD_ASSIGN";
+	case OpCode::SUB_ASSIGN: return "SUB_ASSIGN";
+	case OpCode::MUL_ASSIGN: return "MUL_ASSIGN";
+	case OpCode::DIV_ASSIGN: return "DIV_ASSIGN";
+	case OpCode::MOD_ASSIGN: return "MOD_ASSIGN";
+	case OpCode::INT_DIV_ASSIGN: return "INT_DIV_ASSIGN";
+	case OpCode::NOT: return "NOT";
+	case OpCode::NEGATE: return "NEGATE";
+	case OpCode::PLUS: return "PLUS";
+	case OpCode::PRE_INCR: return "PRE_INCR";
+	case OpCode::PRE_DECR: return "PRE_DECR";
+	case OpCode::POST_INCR: return "POST_INCR";
+	case OpCode::POST_DECR: return "POST_DECR";
+	case OpCode::GET_METHOD: return "GET_METHOD";
+	case OpCode::CALL: return "CALL";
+	case OpCode::CALL_METHOD: return "CALL_METHOD";
+	case OpCode::SUBSCRIPT: return "SUBSCRIPT";
+	case OpCode::SUBSCRIPT_CHAIN: return "SUBSCRIPT_CHAIN";
+	case OpCode::LIST: return "LIST";
+	case OpCode::JUMP: return "JUMP";
+	case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+	case OpCode::ENTER_BLOCK: return "ENTER_BLOCK";
+	case OpCode::EXIT_BLOCK: return "EXIT_BLOCK";
+	case OpCode::FOR_CHECK: return "FOR_CHECK";
+	case OpCode::SET: return "SET";
+	case OpCode::INCR: return "INCR";
+	case OpCode::FOR_LOOP: return "FOR_LOOP";
+	case OpCode::FUNCTION: return "FUNCTION";
+	case OpCode::RETURN: return "RETURN";
+	case OpCode::RETURN_ERROR: return "RETURN_ERROR";
+	case OpCode::RELEASE_LOCKS: return "RELEASE_LOCKS";
+	case OpCode::HALT: return "HALT";
+	}
+	return "?";
+}
+
+static std::string describeConstant(const Object& obj)
+{
+	auto& constant = const_cast<Object&>(obj);
+	if (const auto* array = std::get_if<Ref<ArrayContainer>>(&constant.data))
+	{
+		// Element by element, i.e. [1, "a", [2, 3]]
+		const std::unique_ptr<Object> size((*array)->size({}));
+		std::string result = "[";
+		for (int i = 0; i < std::get<int>(size->data); i++)
+		{
+			Object index(i), element;
+			Object* indexPtr = &index;
+			if (i) result += ", ";
+			result += describeConstant(*(*array)->getArray(Args(&indexPtr, 1), element));
+		}
+		return result + "]";
+	}
+	if (std::holds_alternative<Ref<StringContainer>>(constant.data))
+		return '"' + constant.toStr() + '"';
+	if (std::holds_alternative<char>(constant.data))
+		return '\'' + constant.toStr() + '\'';
+	return constant.toStr();
+}
+
+static std::string describeBinding(const IDNode& idNode)
+{
+	// I.e. "x [1:0, 0:2]" for x in slot 0 of depth 1, or else in slot 2 of depth 0
+	const Binding& binding = idNode.getBinding();
+	std::string result = idNode.getID();
+	std::vector<std::string> places;
+	for (const auto& [depth, slot] : binding.slots)
+	{
+		places.push_back(std::to_string(depth) + ":" + std::to_string(slot));
+	}
+	if (binding.builtin >= 0)
+		places.push_back("builtin " + std::to_string(binding.builtin));
+	if (binding.dynamic) places.emplace_back("by name");
+	if (places.empty()) return result;
+	result += " [";
+	for (size_t i = 0; i != places.size(); i++)
+	{
+		result += (i) ? (", " + places[i]) : (places[i]);
+	}
+	return result + "]";
+}
+
+static void disassembleUnit(const Proto& proto, std::ostringstream& out)
+{
+	out << "== " << proto.name << " == " << proto.nRegs << " registers, "
+		<< proto.constants.size() << " constants, " << proto.ids.size()
+		<< " identifiers\n";
+	for (size_t i = 0; i != proto.code.size(); i++)
+	{
+		const Instruction& ins = proto.code[i];
+		std::ostringstream operands, comment;
+		const auto r = [](const unsigned reg)
+		{
+			std::string name = "r";
+			return name += std::to_string(reg);
+		};
+		switch (ins.op)
+		{
+		case OpCode::LOAD_CONST:
+			operands << r(ins.a) << ", k" << ins.b;
+			comment << describeConstant(proto.constants[ins.b]);
+			break;
+		case OpCode::LOAD_NAME:
+		case OpCode::DEF_NAME:
+			operands << r(ins.a) << ", i" << ins.b;
+			comment << describeBinding(*proto.ids[ins.b]);
+			break;
+		case OpCode::GET_METHOD:
+			operands << r(ins.a) << ", n" << ins.b;
+			comment << proto.names[ins.b];
+			break;
+		case OpCode::CALL_METHOD:
+			operands << r(ins.a) << ", m" << ins.b << ", " << ins.c;
+			comment << proto.methodCalls[ins.b].name << ", " << ins.c
+				<< " operand(s) from " << r(ins.a + 1);
+			break;
+		case OpCode::ENTER_BLOCK:
+			operands << ins.b;
+			comment << ins.b << " slot(s)";
+			break;
+		case OpCode::COPY:
+		case OpCode::MOVE:
+		case OpCode::SELECT:
+		case OpCode::SET:
+		case OpCode::NOT:
+		case OpCode::NEGATE:
+		case OpCode::PLUS:
+		case OpCode::PRE_INCR:
+		case OpCode::PRE_DECR:
+		case OpCode::POST_INCR:
+		case OpCode::POST_DECR:
+		case OpCode::FOR_CHECK:
+			operands << r(ins.a) << ", " << r(ins.b);
+			break;
+		case OpCode::NOT_VOID:
+		case OpCode::INCR:
+		case OpCode::RETURN:
+			operands << r(ins.a);
+			break;
+		case OpCode::CALL:
+		case OpCode::SUBSCRIPT:
+		case OpCode::SUBSCRIPT_CHAIN:
+		case OpCode::LIST:
+			operands << r(ins.a) << ", " << ins.c;
+			comment << ins.c << " operand(s) from " << r(ins.a + 1);
+			break;
+		case OpCode::JUMP:
+			operands << "-> " << ins.c;
+			break;
+		case OpCode::JUMP_IF_FALSE:
+			operands << r(ins.a) << ", -> " << ins.c;
+			break;
+		case OpCode::FOR_LOOP:
+			operands << r(ins.a) << ", " << r(ins.b) << ", -> " << ins.c;
+			break;
+		case OpCode::FUNCTION:
+			operands << r(ins.a) << ", u" << ins.b;
+			comment << "method " << proto.protos[ins.b]->name;
+			break;
+		case OpCode::EXIT_BLOCK:
+		case OpCode::RETURN_ERROR:
+		case OpCode::RELEASE_LOCKS:
+		case OpCode::HALT:
+			break;
+		default: // Binary operators and assignments
+			operands << r(ins.a) << ", " << r(ins.b) << ", " << r(ins.c);
+			break;
+		}
+		out << std::setw(6) << i << "  " << std::left << std::setw(16)
+			<< opCodeName(ins.op) << std::setw(16) << operands.str()
+			<< std::right;
+		if (!comment.str().empty()) out << "; " << comment.str();
+		if (proto.positions[i] != NO_POS) out << "  @" << proto.positions[i];
+		out << '\n';
+	}
+	for (const auto& method : proto.protos)
+	{
+		out << '\n';
+		disassembleUnit(*method, out);
+	}
+}
+
+std::string disassemble(const Proto& proto)
+{
+	std::ostringstream out;
+	disassembleUnit(proto, out);
+	return out.str();
+}
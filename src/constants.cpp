@@ -0,0 +1,55 @@
+/* constants.cpp */
+
+#include "constants.h"
+#include <cstring>
+#include <optional>
+
+/* Overload structure to access std::variant */
+template <class... Ts>
+struct overload : Ts...
+{
+	using Ts::operator()...;
+};
+
+template <typename T>
+static std::string bytesOf(const T val)
+{
+	std::string bytes(sizeof(T), '\0');
+	std::memcpy(bytes.data(), &val, sizeof(T));
+	return bytes;
+}
+
+// The key of a value in the index. Arrays are not looked up, each list literal has
+// its own value.
+static std::optional<std::string> keyOf(const Object& obj)
+{
+	return std::visit(overload{
+		                  [](const int x) -> std::optional<std::string> { return bytesOf(x); },
+		                  [](const float x) -> std::optional<std::string> { return bytesOf(x); },
+		                  [](const bool x) -> std::optional<std::string> { return bytesOf(x); },
+		                  [](const char x) -> std::optional<std::string> { return bytesOf(x); },
+		                  [](const Ref<StringContainer>& sc) -> std::optional<std::string>
+		                  {
+			                  return std::string(sc->getStr());
+		                  },
+		                  [](const auto&) -> std::optional<std::string> { return {}; }
+	                  }, obj.data);
+}
+
+ConstantPool::ConstantPool() = default;
+ConstantPool::ConstantPool(ConstantPool&&) noexcept = default;
+ConstantPool& ConstantPool::operator=(ConstantPool&&) noexcept = default;
+ConstantPool::~ConstantPool() = default;
+
+const Object* ConstantPool::intern(const Object& obj)
+{
+	const std::optional<std::string> key = keyOf(obj);
+	if (key)
+	{
+		const auto itr = index.find({obj.data.index(), *key});
+		if (itr != index.end()) return itr->second;
+	}
+	const Object* value = &values.emplace_back(obj);
+	if (key) index[{obj.data.index(), *key}] = value;
+	return value;
+}
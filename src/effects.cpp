@@ -0,0 +1,125 @@
+/* effects.cpp */
+
+#include "effects.h"
+#include "AST.h"
+#include <algorithm>
+
+Effects::Effects(const Scope& globalScope) : globalScope(globalScope)
+{
+}
+
+void Effects::addRead(const std::string& id) { reads.insert(id); }
+void Effects::addWrite(const std::string& id) { writes.insert(id); }
+
+void Effects::addCall(const ASTNode* callee)
+{
+	// input() assigns to its arguments, which are marked as written (see nAryNode)
+	if (const auto* idNode = dynamic_cast<const IDNode*>(callee))
+	{
+		if (globalScope.getSlot(idNode->getID(), 0) >= 0) return;
+	}
+	else if (callee && callee->isMethod()) return; // Changes its receiver, which is written too
+	callsFunction = true;
+}
+
+bool Effects::mayChange(const Effects& expr) const
+{
+	if (callsFunction) return true;
+	return std::any_of(expr.reads.begin(), expr.reads.end(),
+	                   [this](const std::string& id) { return writes.contains(id); });
+}
+
+void CodeBlock::addEffects(Effects& effects) const
+{
+	for (const Statement* st : statementVec)
+	{
+		st->addEffects(effects);
+	}
+}
+
+void Statement::addEffects(Effects&) const
+{
+}
+
+void IfStatement::addEffects(Effects& effects) const
+{
+	for (const auto& [casePtr, blockPtr] : cases)
+	{
+		casePtr->addEffects(effects);
+		blockPtr->addEffects(effects);
+	}
+}
+
+void WhileStatement::addEffects(Effects& effects) const
+{
+	condition->addEffects(effects);
+	block->addEffects(effects);
+}
+
+void ForStatement::addEffects(Effects& effects) const
+{
+	lowerNode->addEffects(effects);
+	upperNode->addEffects(effects);
+	if (const auto* idNode = dynamic_cast<const IDNode*>(counterNode))
+		effects.addWrite(idNode->getID());
+	block->addEffects(effects);
+}
+
+void ExprStatement::addEffects(Effects& effects) const
+{
+	exprRoot->addEffects(effects);
+}
+
+void ReturnStatement::addEffects(Effects& effects) const
+{
+	returnRoot->addEffects(effects);
+}
+
+void FunctionDefStatement::addEffects(Effects& effects) const
+{
+	// The block only runs when the function is called
+	if (const auto* idNode = dynamic_cast<const IDNode*>(funcID))
+		effects.addWrite(idNode->getID());
+}
+
+void ASTNode::addEffects(Effects& effects) const
+{
+	effects.addCall(nullptr); // Unknown, it may do anything
+}
+
+void nAryNode::addEffects(Effects& effects) const
+{
+	if (opType == OperatorType::FUNCTION_CALL) effects.addCall(mainOperand);
+	for (const ASTNode* node : nOperands)
+	{
+		node->addEffects(effects);
+	}
+	// The variable of a subscript that is written is written too (see setWritten())
+	if (mainOperand) mainOperand->addEffects(effects);
+}
+
+void BinaryNode::addEffects(Effects& effects) const
+{
+	left->addEffects(effects); // The lhs of an assignment is marked as written
+	if (opType != OperatorType::MEMBER_ACCESS) right->addEffects(effects);
+}
+
+void UnaryNode::addEffects(Effects& effects) const
+{
+	operand->addEffects(effects);
+}
+
+void LiteralNode::addEffects(Effects&) const
+{
+}
+
+void HoistedNode::addEffects(Effects& effects) const
+{
+	expr->addEffects(effects);
+}
+
+void IDNode::addEffects(Effects& effects) const
+{
+	effects.addRead(id);
+	if (written) effects.addWrite(id);
+}
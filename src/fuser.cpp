@@ -0,0 +1,244 @@
+/* fuser.cpp */
+
+#include "fuser.h"
+#include "AST.h"
+#include <climits>
+
+Fuser::Fuser(Arena& arena) : arena(arena)
+{
+}
+
+void Fuser::fuse(CodeBlock* mainBlock)
+{
+	mainBlock->fuse(*this);
+}
+
+// An identifier that gives the variable itself, not a copy
+static bool isVariable(const ASTNode* node)
+{
+	return dynamic_cast<const IDNode*>(node) && !node->isForceRval();
+}
+
+// A variable, a hoisted expression (see loops.h), or a literal number, bool or char
+static bool isLeaf(const ASTNode* node)
+{
+	if (isVariable(node) || dynamic_cast<const HoistedNode*>(node)) return true;
+	const auto* literal = dynamic_cast<const LiteralNode*>(node);
+	if (!literal) return false;
+	const VariantType& data = literal->getValue().data;
+	return std::holds_alternative<int>(data) || std::holds_alternative<float>(data) ||
+		std::holds_alternative<bool>(data) || std::holds_alternative<char>(data);
+}
+
+// The value of an int literal, other than the one that can't be negated
+static bool isIntLiteral(const ASTNode* node, int& value)
+{
+	const auto* literal = dynamic_cast<const LiteralNode*>(node);
+	if (!literal) return false;
+	const int* x = std::get_if<int>(&literal->getValue().data);
+	if (!x || *x == INT_MIN) return false;
+	value = *x;
+	return true;
+}
+
+static bool isSameVariable(const ASTNode* node1, const ASTNode* node2)
+{
+	return isVariable(node1) && isVariable(node2) &&
+		static_cast<const IDNode*>(node1)->getID() == static_cast<const IDNode*>(node2)->
+		getID();
+}
+
+static bool isAssignment(const OperatorType opType)
+{
+	switch (opType)
+	{
+	case OperatorType::ASSIGNMENT:
+	case OperatorType::ADDITION_ASSIGN:
+	case OperatorType::SUBTRACTION_ASSIGN:
+	case OperatorType::MULTIPLICATION_ASSIGN:
+	case OperatorType::DIVISION_ASSIGN:
+	case OperatorType::MODULO_ASSIGN:
+	case OperatorType::DIV_ASSIGN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+ASTNode* Fuser::fuseCall(nAryNode* node)
+{
+	for (ASTNode*& operand : node->nOperands)
+	{
+		operand = operand->fuse(*this);
+	}
+	if (node->mainOperand) node->mainOperand = node->mainOperand->fuse(*this);
+	if (MethodCallNode* fused = fuseMethodCall(node, node, false)) return fused;
+	return node;
+}
+
+MethodCallNode* Fuser::fuseMethodCall(nAryNode* call, ASTNode* original, const bool negated)
+{
+	if (call->opType != OperatorType::FUNCTION_CALL) return nullptr;
+	const auto* member = dynamic_cast<BinaryNode*>(call->mainOperand);
+	if (!member || member->opType != OperatorType::MEMBER_ACCESS || !member->methodID ||
+		!isVariable(member->left))
+		return nullptr;
+	return arena.make<MethodCallNode>(original, member, member->left, call->nOperands,
+	                                  negated, call->getPos());
+}
+
+ASTNode* Fuser::fuseBinary(BinaryNode* node)
+{
+	if (ASTNode* fused = fuseIncrement(node)) return fused;
+	node->left = node->left->fuse(*this);
+	// The method name isn't an expression
+	if (node->opType == OperatorType::MEMBER_ACCESS) return node;
+	node->right = node->right->fuse(*this);
+	if (ASTNode* fused = fuseStore(node)) return fused;
+	if (!isAssignment(node->opType) && node->opType != OperatorType::COMMA &&
+		binaryOperator(node->opType) && isLeaf(node->left) && isLeaf(node->right))
+		return arena.make<LeafBinaryNode>(node, node->left, node->right, node->opType,
+		                                  node->getPos());
+	return node;
+}
+
+ASTNode* Fuser::fuseIncrement(BinaryNode* node)
+{
+	int amount = 0;
+	switch (node->opType)
+	{
+	case OperatorType::ASSIGNMENT: // i = i + 1 or i = i - 1
+		{
+			const auto* sum = dynamic_cast<BinaryNode*>(node->right);
+			if (!sum || (sum->opType != OperatorType::ADDITION &&
+					sum->opType != OperatorType::SUBTRACTION) ||
+				!isSameVariable(node->left, sum->left) || !isIntLiteral(sum->right, amount))
+				return nullptr;
+			if (sum->opType == OperatorType::SUBTRACTION) amount = -amount;
+			return arena.make<IncrementNode>(node, node->left, amount, false, true);
+		}
+	case OperatorType::ADDITION_ASSIGN:
+	case OperatorType::SUBTRACTION_ASSIGN:
+		if (!isVariable(node->left) || !isIntLiteral(node->right, amount)) return nullptr;
+		if (node->opType == OperatorType::SUBTRACTION_ASSIGN) amount = -amount;
+		return arena.make<IncrementNode>(node, node->left, amount, false, false);
+	default:
+		return nullptr;
+	}
+}
+
+ASTNode* Fuser::fuseStore(BinaryNode* node)
+{
+	auto* subscript = dynamic_cast<nAryNode*>(node->left);
+	if (node->opType != OperatorType::ASSIGNMENT || !subscript ||
+		subscript->opType != OperatorType::SUBSCRIPT ||
+		!isVariable(subscript->mainOperand) || !node->right->isPure())
+		return nullptr;
+	return arena.make<StoreNode>(node, subscript, subscript->mainOperand,
+	                             subscript->nOperands, node->right, node->getPos());
+}
+
+ASTNode* Fuser::fuseUnary(UnaryNode* node)
+{
+	switch (node->opType)
+	{
+	case OperatorType::PRE_INCR:
+	case OperatorType::PRE_DECR:
+	case OperatorType::POST_INCR:
+	case OperatorType::POST_DECR:
+		if (isVariable(node->operand))
+		{
+			const bool isIncrement = node->opType == OperatorType::PRE_INCR ||
+				node->opType == OperatorType::POST_INCR;
+			const bool isPostfix = node->opType == OperatorType::POST_INCR ||
+				node->opType == OperatorType::POST_DECR;
+			return arena.make<IncrementNode>(node, node->operand, (isIncrement) ? (1) : (-1),
+			                                 isPostfix, false);
+		}
+		break;
+	default:
+		break;
+	}
+	node->operand = node->operand->fuse(*this);
+	// not S.isEmpty()
+	const auto* call = dynamic_cast<MethodCallNode*>(node->operand);
+	if (node->opType == OperatorType::NOT && call && !call->negated)
+		return arena.make<MethodCallNode>(node, call->member, call->receiver, call->args,
+		                                  true, call->getPos());
+	return node;
+}
+
+void CodeBlock::fuse(Fuser& fuser)
+{
+	for (Statement* st : statementVec)
+	{
+		st->fuse(fuser);
+	}
+}
+
+void Statement::fuse(Fuser&)
+{
+}
+
+void IfStatement::fuse(Fuser& fuser)
+{
+	for (auto& [casePtr, blockPtr] : cases)
+	{
+		casePtr = casePtr->fuse(fuser);
+		blockPtr->fuse(fuser);
+	}
+}
+
+void WhileStatement::fuse(Fuser& fuser)
+{
+	condition = condition->fuse(fuser);
+	block->fuse(fuser);
+}
+
+void ForStatement::fuse(Fuser& fuser)
+{
+	lowerNode = lowerNode->fuse(fuser);
+	upperNode = upperNode->fuse(fuser);
+	block->fuse(fuser);
+}
+
+void ExprStatement::fuse(Fuser& fuser)
+{
+	exprRoot = exprRoot->fuse(fuser);
+}
+
+void ReturnStatement::fuse(Fuser& fuser)
+{
+	returnRoot = returnRoot->fuse(fuser);
+}
+
+void FunctionDefStatement::fuse(Fuser& fuser)
+{
+	block->fuse(fuser);
+}
+
+ASTNode* ASTNode::fuse(Fuser&)
+{
+	return this;
+}
+
+ASTNode* nAryNode::fuse(Fuser& fuser)
+{
+	return fuser.fuseCall(this);
+}
+
+ASTNode* BinaryNode::fuse(Fuser& fuser)
+{
+	return fuser.fuseBinary(this);
+}
+
+ASTNode* UnaryNode::fuse(Fuser& fuser)
+{
+	return fuser.fuseUnary(this);
+}
+
+ASTNode* HoistedNode::fuse(Fuser& fuser)
+{
+	expr = expr->fuse(fuser);
+	return this;
+}
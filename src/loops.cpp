@@ -0,0 +1,198 @@
+/* loops.cpp */
+
+#include "loops.h"
+#include "AST.h"
+
+LoopOptimizer::LoopOptimizer(const Scope& globalScope, Arena& arena) :
+	globalScope(globalScope), arena(arena)
+{
+}
+
+void LoopOptimizer::optimize(CodeBlock* mainBlock)
+{
+	mainBlock->optimizeLoops(*this);
+}
+
+Effects LoopOptimizer::makeEffects() const
+{
+	return Effects(globalScope);
+}
+
+bool LoopOptimizer::isInvariant(const ASTNode* expr, const Effects& loop) const
+{
+	if (!expr->isPure()) return false;
+	Effects exprEffects(globalScope);
+	expr->addEffects(exprEffects);
+	return !loop.mayChange(exprEffects);
+}
+
+void LoopOptimizer::beginLoop(const Effects& loop, std::vector<HoistedNode*>& hoisted)
+{
+	this->loop = &loop;
+	this->hoisted = &hoisted;
+}
+
+void LoopOptimizer::endLoop()
+{
+	loop = nullptr;
+	hoisted = nullptr;
+}
+
+// Variables and literals are used where they are, there is nothing to save
+static bool isWorthHoisting(const ASTNode* expr)
+{
+	return !dynamic_cast<const IDNode*>(expr) && !dynamic_cast<const LiteralNode*>(expr) &&
+		!dynamic_cast<const HoistedNode*>(expr);
+}
+
+ASTNode* LoopOptimizer::hoist(ASTNode* expr)
+{
+	if (isWorthHoisting(expr) && isInvariant(expr, *loop))
+	{
+		auto* node = arena.make<HoistedNode>(expr);
+		hoisted->push_back(node);
+		return node;
+	}
+	expr->hoistOperands(*this);
+	return expr;
+}
+
+void CodeBlock::optimizeLoops(LoopOptimizer& optimizer)
+{
+	for (Statement* st : statementVec)
+	{
+		st->optimizeLoops(optimizer);
+	}
+}
+
+void Statement::optimizeLoops(LoopOptimizer&)
+{
+}
+
+void IfStatement::optimizeLoops(LoopOptimizer& optimizer)
+{
+	for (const auto& [casePtr, blockPtr] : cases)
+	{
+		blockPtr->optimizeLoops(optimizer);
+	}
+}
+
+void WhileStatement::optimizeLoops(LoopOptimizer& optimizer)
+{
+	// The condition is evaluated again before every iteration
+	Effects loop = optimizer.makeEffects();
+	condition->addEffects(loop);
+	block->addEffects(loop);
+	optimizer.beginLoop(loop, hoisted);
+	condition = optimizer.hoist(condition);
+	block->hoist(optimizer);
+	optimizer.endLoop();
+	// The inner loops hoist what is left
+	block->optimizeLoops(optimizer);
+}
+
+void ForStatement::optimizeLoops(LoopOptimizer& optimizer)
+{
+	// The limits are evaluated again after every iteration, where the counter and the
+	// body may have changed them
+	Effects loop = optimizer.makeEffects();
+	if (const auto* idNode = dynamic_cast<const IDNode*>(counterNode))
+		loop.addWrite(idNode->getID());
+	lowerNode->addEffects(loop);
+	upperNode->addEffects(loop);
+	block->addEffects(loop);
+	counted = optimizer.isInvariant(lowerNode, loop) &&
+		optimizer.isInvariant(upperNode, loop);
+	optimizer.beginLoop(loop, hoisted);
+	if (!counted) // Otherwise the limits are evaluated once anyway
+	{
+		lowerNode = optimizer.hoist(lowerNode);
+		upperNode = optimizer.hoist(upperNode);
+	}
+	block->hoist(optimizer);
+	optimizer.endLoop();
+	block->optimizeLoops(optimizer);
+}
+
+void ExprStatement::optimizeLoops(LoopOptimizer&)
+{
+}
+
+void ReturnStatement::optimizeLoops(LoopOptimizer&)
+{
+}
+
+void FunctionDefStatement::optimizeLoops(LoopOptimizer& optimizer)
+{
+	block->optimizeLoops(optimizer);
+}
+
+void CodeBlock::hoist(LoopOptimizer& optimizer)
+{
+	for (Statement* st : statementVec)
+	{
+		st->hoist(optimizer);
+	}
+}
+
+void Statement::hoist(LoopOptimizer&)
+{
+	// A function defined in a loop runs when it is called, maybe after the loop
+}
+
+void IfStatement::hoist(LoopOptimizer& optimizer)
+{
+	for (auto& [casePtr, blockPtr] : cases)
+	{
+		casePtr = optimizer.hoist(casePtr);
+		blockPtr->hoist(optimizer);
+	}
+}
+
+void WhileStatement::hoist(LoopOptimizer& optimizer)
+{
+	condition = optimizer.hoist(condition);
+	block->hoist(optimizer);
+}
+
+void ForStatement::hoist(LoopOptimizer& optimizer)
+{
+	lowerNode = optimizer.hoist(lowerNode);
+	upperNode = optimizer.hoist(upperNode);
+	block->hoist(optimizer);
+}
+
+void ExprStatement::hoist(LoopOptimizer& optimizer)
+{
+	exprRoot = optimizer.hoist(exprRoot);
+}
+
+void ReturnStatement::hoist(LoopOptimizer& optimizer)
+{
+	returnRoot = optimizer.hoist(returnRoot);
+}
+
+void ASTNode::hoistOperands(LoopOptimizer&)
+{
+}
+
+void nAryNode::hoistOperands(LoopOptimizer& optimizer)
+{
+	if (mainOperand) mainOperand = optimizer.hoist(mainOperand);
+	for (ASTNode*& node : nOperands)
+	{
+		node = optimizer.hoist(node);
+	}
+}
+
+void BinaryNode::hoistOperands(LoopOptimizer& optimizer)
+{
+	left = optimizer.hoist(left);
+	// The method name isn't an expression
+	if (opType != OperatorType::MEMBER_ACCESS) right = optimizer.hoist(right);
+}
+
+void UnaryNode::hoistOperands(LoopOptimizer& optimizer)
+{
+	operand = optimizer.hoist(operand);
+}
@@ -1,7 +1,10 @@
 /* object.cpp */
 
 #include "object.h"
+#include "AST.h"
 #include "errors.h"
+#include <algorithm>
+#include <deque>
 #include <iostream>
 
 /* Overload structure to access std::variant */
@@ -11,55 +14,222 @@ struct overload : Ts...
 	using Ts::operator()...;
 };
 
-ArrayContainer::ArrayContainer() { addMethods(); }
+template <typename C>
+static constexpr bool isConstMethod(Object* (C::*)(Args) const)
+{
+	return true;
+}
+
+template <typename C>
+static constexpr bool isConstMethod(Object* (C::*)(Args))
+{
+	return false;
+}
+
+// Calls a method of a container, on the container held by the receiver
+template <typename C, auto method>
+static Object* callMethod(Object& receiver, Args args)
+{
+	if constexpr (!isConstMethod(method)) receiver.prepareWrite();
+	return (std::get<Ref<C>>(receiver.data).get()->*method)(args);
+}
+
+// The methods that aren't const modify their container
+template <typename C, auto method>
+static MethodEntry entry(const std::string& name)
+{
+	return {name, &callMethod<C, method>, !isConstMethod(method)};
+}
+
+static Method lookupMethod(const MethodTable& methods, const std::string& name)
+{
+	for (const MethodEntry& entry : methods)
+	{
+		if (entry.name == name) return entry.method;
+	}
+	return nullptr;
+}
+
+// An element of a packed container that is being changed (see Object::storeBack)
+struct PendingStore
+{
+	Object proxy;
+	PackedContainer container;
+	size_t index = 0;
+};
+
+// A deque, so the proxies stay in place while others are added
+static std::deque<PendingStore> pendingStores;
+
+ArrayContainer::ArrayContainer() = default;
 
 ArrayContainer::ArrayContainer(const ArrayContainer& ac)
 {
-	copyArrays(array, ac.array);
-	addMethods();
+	*this = ac;
 }
 
 ArrayContainer& ArrayContainer::operator=(const ArrayContainer& ac2)
 {
-	copyArrays(array, ac2.array);
-	// In the assignment constructor, we needn't run addMethods as
-	// the methods are already loaded in c2
+	std::visit(overload{
+		           [this](const ArrayType& elements)
+		           {
+			           ArrayType copy;
+			           copyArrays(copy, elements);
+			           array = std::move(copy);
+		           },
+		           // Packed values are copied as they are
+		           [this]<typename T>(const std::vector<T>& values) { array = values; }
+	           }, ac2.array);
+	shape = ac2.shape;
 	return *this;
 }
 
 
-ArrayContainer::ArrayContainer(const std::vector<Object*>& listVec)
+ArrayContainer::ArrayContainer(Args listVec)
 {
+	if (pack<int>(listVec) || pack<float>(listVec) || pack<bool>(listVec) ||
+		pack<char>(listVec) || packArrays(listVec))
+		return;
+	ArrayType elements;
 	for (size_t i = 0; i != listVec.size(); i++)
 	{ // Initialize array with given vector of objects
-		array.emplace_back(std::make_unique<Object>(*listVec[i]));
+		elements.emplace_back(std::make_unique<Object>(*listVec[i]));
 		// Unique ptr used for auto mem management
+		elements.back()->setLval(true); // The elements can be assigned to
 	}
+	array = std::move(elements);
 }
 
 // I.e. if dimVec = {2, 3}, it's a 2D 2x3 array
 ArrayContainer::ArrayContainer(const std::vector<size_t>& dimVec)
 {
-	for (size_t i = 0; i != dimVec[0]; i++) // Look at the first dimension
+	size_t length = 1;
+	for (const size_t dim : dimVec) length *= dim;
+	array = std::vector<int>(length); // The elements are 0
+	if (dimVec.size() > 1) shape = dimVec;
+}
+
+ArrayContainer::ArrayContainer(const ArrayContainer& ac, const size_t nIndices,
+                               const size_t offset)
+	: shape(ac.shape.begin() + nIndices, ac.shape.end())
+{
+	size_t length = 1;
+	for (const size_t dim : shape) length *= dim;
+	if (shape.size() == 1) shape.clear(); // A 1D array
+	std::visit(overload{
+		           [](const ArrayType&)
+		           {
+		           },
+		           [this, length, offset]<typename T>(const std::vector<T>& values)
+		           {
+			           array = std::vector<T>(values.begin() + offset * length,
+			                                  values.begin() + (offset + 1) * length);
+		           }
+	           }, ac.array);
+}
+
+template <typename T>
+bool ArrayContainer::pack(Args listVec)
+{
+	std::vector<T> values;
+	values.reserve(listVec.size());
+	for (const Object* obj : listVec)
+	{
+		const T* value = std::get_if<T>(&obj->data);
+		if (!value) return false;
+		values.push_back(*value);
+	}
+	array = std::move(values);
+	return true;
+}
+
+bool ArrayContainer::packArrays(Args listVec)
+{
+	// The arrays must be packed with the same type and shape
+	std::vector<const ArrayContainer*> subArrays;
+	for (const Object* obj : listVec)
+	{
+		const auto* ac = std::get_if<Ref<ArrayContainer>>(&obj->data);
+		if (!ac || std::holds_alternative<ArrayType>((*ac)->array)) return false;
+		if (!subArrays.empty() && ((*ac)->array.index() != subArrays[0]->array.index()
+			|| (*ac)->getShape() != subArrays[0]->getShape()))
+			return false;
+		subArrays.push_back(ac->get());
+	}
+	if (subArrays.empty()) return false;
+	shape = subArrays[0]->getShape();
+	shape.insert(shape.begin(), subArrays.size());
+	std::visit(overload{
+		           [](const ArrayType&)
+		           {
+		           },
+		           [this, &subArrays]<typename T>(const std::vector<T>& first)
+		           {
+			           std::vector<T> values;
+			           values.reserve(subArrays.size() * first.size());
+			           for (const ArrayContainer* ac : subArrays)
+			           {
+				           const auto& subValues = std::get<std::vector<T>>(ac->array);
+				           values.insert(values.end(), subValues.begin(), subValues.end());
+			           }
+			           array = std::move(values);
+		           }
+	           }, subArrays[0]->array);
+	return true;
+}
+
+void ArrayContainer::unpack()
+{
+	ArrayType elements;
+	std::visit(overload{
+		           [&elements](ArrayType& unpacked) { elements = std::move(unpacked); },
+		           [&elements]<typename T>(std::vector<T>& values)
+		           {
+			           elements.reserve(values.size());
+			           for (size_t i = 0; i != values.size(); i++)
+			           {
+				           elements.emplace_back(std::make_unique<Object>(T(values[i])));
+				           elements.back()->setLval(true);
+			           }
+		           }
+	           }, array);
+	array = std::move(elements);
+}
+
+void ArrayContainer::split()
+{
+	const size_t nSubArrays = shape[0];
+	const size_t length = std::visit([](const auto& values) { return values.size(); },
+	                                 array) / nSubArrays;
+	ArrayType elements;
+	for (size_t i = 0; i != nSubArrays; i++)
+	{
+		elements.emplace_back(
+			std::make_unique<Object>(makeRef<ArrayContainer>(*this, 1, i)));
+		elements.back()->setLval(true);
+	}
+	// The proxies of elements being changed go to the sub-arrays
+	for (PendingStore& pending : pendingStores)
 	{
-		Object* objPtr = nullptr;
-		if (dimVec.size() == 1) // If only one dimension
-			objPtr = new Object(); // Initialize one object
-		else // If more than one
-			// Element is another array of dimensions dimArray[1:] (exclude 1st)
-			objPtr = new Object(
-				std::make_shared<ArrayContainer>(
-					std::vector(dimVec.begin() + 1, dimVec.end())));
-		objPtr->setLval(true);
-		array.emplace_back(objPtr);
+		if (pending.container != PackedContainer(this)) continue;
+		pending.container =
+			std::get<Ref<ArrayContainer>>(elements[pending.index / length]->data).get();
+		pending.index %= length;
 	}
+	array = std::move(elements);
+	shape.clear();
 }
 
+std::vector<size_t> ArrayContainer::getShape() const
+{
+	if (!shape.empty()) return shape;
+	return {std::visit([](const auto& elements) { return elements.size(); }, array)};
+}
 
-Object* ArrayContainer::size(const std::vector<Object*>& argVec) const
+Object* ArrayContainer::size(Args argVec) const
 { // Get size of the array - no arguments expected
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
-	return new Object(static_cast<int>(array.size()));
+	return new Object(static_cast<int>(getShape()[0]));
 }
 
 void ArrayContainer::copyArrays(ArrayType& a1, const ArrayType& a2) const
@@ -73,27 +243,20 @@ void ArrayContainer::copyArrays(ArrayType& a1, const ArrayType& a2) const
 	}
 }
 
-Scope& ArrayContainer::getMethodScope()
-{
-	return methodScope;
-}
-
-
-void ArrayContainer::addMethods()
+const MethodTable& ArrayContainer::getMethods()
 {
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return size(args);
-	}), "size", true); // The only method is size()
+	static const MethodTable methods = {
+		entry<ArrayContainer, &ArrayContainer::size>("size")
+	};
+	return methods;
 }
 
-Object* ArrayContainer::getArray(const std::vector<Object*>& idxVec) const
+// Checks an index of a dimension of the given size
+static size_t checkSubscript(const Object* idxObj, const size_t size)
 {
-	if (idxVec.empty()) // Index must be provided
-		throw ArgumentError("At least 1 array subscript expected.");
 	size_t currIdx = 0;
 	// Check the type and range of the index - must be positive int!
-	if (const int* idx = std::get_if<int>(&idxVec[0]->data))
+	if (const int* idx = std::get_if<int>(&idxObj->data))
 	{
 		if (*idx >= 0) currIdx = static_cast<size_t>(*idx);
 		else throw
@@ -101,61 +264,161 @@ Object* ArrayContainer::getArray(const std::vector<Object*>& idxVec) const
 	}
 	else throw TypeError("Array subscript must be an integer.");
 
-	if (currIdx >= array.size())
+	if (currIdx >= size)
 		throw RangeError("Array subscript out of range.");
-	if (idxVec.size() == 1) // If it is a 1D indexd
+	return currIdx;
+}
+
+size_t ArrayContainer::checkIndex(Args idxVec) const
+{
+	if (idxVec.empty()) // Index must be provided
+		throw ArgumentError("At least 1 array subscript expected.");
+	if (shape.empty())
+	{
+		const size_t currIdx = checkSubscript(
+			idxVec[0], std::visit([](const auto& elements) { return elements.size(); },
+			                      array));
+		// The elements of packed arrays are never containers
+		if (idxVec.size() != 1 && !std::holds_alternative<ArrayType>(array))
+			throw TypeError("Object does not accept a subscript.");
+		return currIdx;
+	}
+	// A multi-dimensional array takes an index per dimension. The offset is counted in
+	// sub-arrays if there are less
+	size_t offset = 0;
+	for (size_t i = 0; i != std::min(idxVec.size(), shape.size()); i++)
 	{
-		return array[currIdx].get(); // Convert std::unique_ptr to raw pointer
+		offset = offset * shape[i] + checkSubscript(idxVec[i], shape[i]);
 	}
-	// If array is more than 1D, take the subsequent the indices and run getArray()
-	// on the element of the current array, which is an array too
-	return (*array[currIdx])[std::vector<Object*>(
-		idxVec.begin() + 1, idxVec.end())];
+	if (idxVec.size() > shape.size())
+		throw TypeError("Object does not accept a subscript.");
+	return offset;
 }
 
-StringContainer::StringContainer() { addMethods(); }
+Object* ArrayContainer::getArray(Args idxVec, Object& tmp) const
+{
+	const size_t currIdx = checkIndex(idxVec);
+	if (idxVec.size() < shape.size())
+	{ // A sub-array, i.e. A[i] of a 2D array, is copied
+		tmp.data = makeRef<ArrayContainer>(*this, idxVec.size(), currIdx);
+		return &tmp;
+	}
+	Object* result = &tmp;
+	std::visit(overload{
+		           [&](const ArrayType& elements)
+		           {
+			           result = elements[currIdx].get();
+			           // If array is more than 1D, take the subsequent the indices and
+			           // run getArray() on the element of the current array, which is an
+			           // array too
+			           if (idxVec.size() != 1)
+			           {
+				           result = result->getElement(idxVec.subspan(1), tmp);
+			           }
+		           },
+		           [&]<typename T>(const std::vector<T>& values)
+		           {
+			           tmp.data = T(values[currIdx]);
+		           }
+	           }, array);
+	return result;
+}
 
-// Similar constructors are used for the string
-StringContainer::StringContainer(const StringContainer& sc2)
+Object* ArrayContainer::getWritable(Args idxVec)
 {
-	copyStrings(string, sc2.string);
-	addMethods();
+	if (idxVec.size() < shape.size()) split(); // A sub-array is changed as a whole
+	const size_t currIdx = checkIndex(idxVec);
+	if (ArrayType* elements = std::get_if<ArrayType>(&array))
+	{
+		if (idxVec.size() == 1) return (*elements)[currIdx].get();
+		return (*elements)[currIdx]->getWritable(idxVec.subspan(1));
+	}
+	Object& proxy = Object::makeProxy(this, currIdx);
+	std::visit(overload{
+		           [](const ArrayType&) {},
+		           [&]<typename T>(const std::vector<T>& values)
+		           {
+			           proxy.data = T(values[currIdx]);
+		           }
+	           }, array);
+	return &proxy;
 }
 
-StringContainer& StringContainer::operator=(const StringContainer& sc2)
+size_t ArrayContainer::getOffset(Args idxVec) const
 {
-	copyStrings(string, sc2.string);
-	return *this;
+	if (std::holds_alternative<ArrayType>(array)) return npos;
+	if (idxVec.size() != std::max<size_t>(shape.size(), 1)) return npos;
+	const size_t size = std::visit([](const auto& values) { return values.size(); }, array);
+	size_t offset = 0;
+	for (size_t i = 0; i != idxVec.size(); i++)
+	{
+		const size_t dim = (shape.empty()) ? (size) : (shape[i]);
+		const int* idx = std::get_if<int>(&idxVec[i]->data);
+		if (!idx || *idx < 0 || static_cast<size_t>(*idx) >= dim) return npos;
+		offset = offset * dim + static_cast<size_t>(*idx);
+	}
+	return offset;
 }
 
-StringContainer::StringContainer(const std::vector<Object*>& argVec)
+void ArrayContainer::store(const size_t index, const Object& value)
+{
+	bool stored = false;
+	std::visit(overload{
+		           [&](ArrayType& elements)
+		           {
+			           *elements[index] = value;
+			           stored = true;
+		           },
+		           [&]<typename T>(std::vector<T>& values)
+		           {
+			           if (const T* x = std::get_if<T>(&value.data))
+			           {
+				           values[index] = *x;
+				           stored = true;
+			           }
+		           }
+	           }, array);
+	if (stored) return;
+	// The value has another type
+	if (shape.empty())
+	{
+		unpack();
+		*std::get<ArrayType>(array)[index] = value;
+		return;
+	}
+	// Only the sub-array the value is in is unpacked
+	const size_t length = std::visit([](const auto& values) { return values.size(); },
+	                                 array) / shape[0];
+	split();
+	std::get<Ref<ArrayContainer>>(std::get<ArrayType>(array)[index / length]->data)->
+		store(index % length, value);
+}
+
+StringContainer::StringContainer() : string(makeRef<std::string>())
+{
+}
+
+StringContainer::StringContainer(Args argVec)
+	: string(makeRef<std::string>())
 { // Check for approriate argument number
 	if (!argVec.empty()) throw ArgumentError(
 		"String constructor does not take any arguments!");
-	addMethods();
 }
 
-StringContainer::StringContainer(const std::string& str)
+StringContainer::StringContainer(std::string str)
+	: string(makeRef<std::string>(std::move(str))), size(string->size())
 { // Initialize a StringCOntainer with a string
-	addMethods();
-	for (size_t i = 0; i != str.length(); i++)
-	{
-		const auto objPtr = new Object(str[i]);
-		objPtr->setLval(true);
-		objPtr->setPersistentType(true); // String can only contain chars
-		string.emplace_back(objPtr);
-	}
 }
 
-void StringContainer::addMethods()
+const MethodTable& StringContainer::getMethods()
 {
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return length(args);
-	}), "length", true); // Returns the length of the string
+	static const MethodTable methods = {
+		entry<StringContainer, &StringContainer::length>("length")
+	};
+	return methods;
 }
 
-Object* StringContainer::getChar(const std::vector<Object*>& idxVec)
+size_t StringContainer::checkIndex(Args idxVec) const
 {
 	if (idxVec.size() != 1)
 		throw ArgumentError("Exactly 1 string subscript expected.");
@@ -167,84 +430,100 @@ Object* StringContainer::getChar(const std::vector<Object*>& idxVec)
 			"String subscript must be a non-negative integer.");
 	}
 	else throw TypeError("String subscript must be an integer.");
-	if (currIdx >= string.size()) // Check index range
+	if (currIdx >= size) // Check index range
 		throw RangeError("String subscript out of range.");
-	return string[currIdx].get(); // Convert std::unique_ptr to raw pointer
+	return currIdx;
 }
 
-std::string StringContainer::getStr() const
-{ // Get std::string from StringContainer
-	std::string str;
-	for (const auto& charObj : string)
-	{
-		// We know that StringContainer only has char type objects
-		str.push_back(std::get<char>(charObj->data));
-	}
-	return str;
+Object* StringContainer::getChar(Args idxVec, Object& tmp) const
+{
+	tmp.data = (*string)[checkIndex(idxVec)];
+	return &tmp;
 }
 
-Object* StringContainer::length(const std::vector<Object*>& argVec)
-{ // Simply get the length of the string
-	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
-	return new Object(static_cast<int>(string.size()));
+Object* StringContainer::getWritable(Args idxVec)
+{
+	const size_t currIdx = checkIndex(idxVec);
+	Object& proxy = Object::makeProxy(this, currIdx);
+	proxy.data = (*string)[currIdx];
+	proxy.setPersistentType(true); // Values assigned to it are cast to chars
+	return &proxy;
+}
+
+void StringContainer::store(const size_t index, const Object& value)
+{
+	const char* c = std::get_if<char>(&value.data);
+	if (!c) throw TypeError("A string can only contain chars.");
+	if (string.isShared()) string = makeRef<std::string>(getStr());
+	(*string)[index] = *c;
 }
 
-void StringContainer::copyStrings(StringType& s1, const StringType& s2) const
-{ // Similar to ArrayContainer
-	s1.clear();
-	for (auto& element : s2)
+void StringContainer::append(const std::string_view str)
+{
+	if (string.isShared() && string->size() != size)
+	{ // Another string uses the rest of the buffer
+		std::string buffer;
+		buffer.reserve(2 * (size + str.size()));
+		buffer.append(getStr()).append(str);
+		string = makeRef<std::string>(std::move(buffer));
+	}
+	else
 	{
-		s1.emplace_back(std::make_unique<Object>(*element));
-		s1.back()->setLval(true);
-		s1.back()->setPersistentType(true);
+		string->resize(size); // Drops the chars no string uses
+		string->append(str);
 	}
+	size += str.size();
 }
 
-Scope& StringContainer::getMethodScope()
-{
-	return methodScope;
+std::string_view StringContainer::getStr() const
+{ // Get the chars of StringContainer
+	return {string->data(), size};
 }
 
+Object* StringContainer::length(Args argVec) const
+{ // Simply get the length of the string
+	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
+	return new Object(static_cast<int>(size));
+}
 
-StackContainer::StackContainer() { addMethods(); }
+StackContainer::StackContainer() = default;
  // Constructors are similar to all others
 StackContainer::StackContainer(const StackContainer& sc2)
 {
 	copyStacks(stack, sc2.stack);
-	addMethods();
 }
 
 StackContainer& StackContainer::operator=(const StackContainer& sc2)
 {
-	copyStacks(stack, sc2.stack);
+	if (this != &sc2) copyStacks(stack, sc2.stack);
 	return *this;
 }
 
-StackContainer::StackContainer(const std::vector<Object*>& argVec)
+StackContainer::StackContainer(Args argVec)
 {
 	if (!argVec.empty()) throw ArgumentError(
 		"Stack constructor does not take any arguments!");
-	addMethods();
 }
 
-Object* StackContainer::push(const std::vector<Object*>& argVec)
+Object* StackContainer::push(Args argVec)
 { // push method
 	if (argVec.size() != 1) throw ArgumentError("Exactly 1 argument expected.");
-	stack.emplace(std::make_unique<Object>(*argVec[0]));
+	stack.emplace_back(std::make_unique<Object>(*argVec[0]));
 	return nullptr;
 }
 
-Object* StackContainer::pop(const std::vector<Object*>& argVec)
+Object* StackContainer::pop(Args argVec)
 { // pop method - returns top element
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	// Throw error if empty stack
 	if (stack.empty()) throw CustomError("Called pop() on empty stack.");
-	const auto poppedObj = new Object(*stack.top()); // Initializes new object
-	stack.pop();
+	// The element is handed over to the caller, not copied
+	Object* poppedObj = stack.back().release();
+	stack.pop_back();
 	return poppedObj;
 }
 
-Object* StackContainer::isEmpty(const std::vector<Object*>& argVec) const
+Object* StackContainer::isEmpty(Args argVec) const
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	return new Object(stack.empty());
@@ -253,145 +532,112 @@ Object* StackContainer::isEmpty(const std::vector<Object*>& argVec) const
 void StackContainer::copyStacks(StackType& stack1,
                                 const StackType& stack2) const
 {
-	// copyStacks requires non-const arguments, even though it doesn't change them
-	auto& stack2_nonconst = const_cast<StackType&>(stack2);
-	// Utilize tmp stack to refill initial stack after everything has been popped
-	StackType tmpStack;
-	stack1 = StackType(); // reset desitnation stack
-	while (!stack2_nonconst.empty())
+	stack1.clear(); // reset desitnation stack
+	stack1.reserve(stack2.size());
+	for (const auto& element : stack2) // Bottom to top
 	{
-		// Create a tmp stack with reversed elements
-		tmpStack.emplace(std::make_unique<Object>(*stack2_nonconst.top()));
-		stack2_nonconst.pop();
-	}
-	while (!tmpStack.empty())
-	{ // Restore initial stack and copy to destination stack
-		stack2_nonconst.emplace(std::make_unique<Object>(*tmpStack.top()));
-		stack1.emplace(std::make_unique<Object>(*tmpStack.top()));
-		tmpStack.pop();
+		stack1.emplace_back(std::make_unique<Object>(*element));
 	}
 }
 
-Scope& StackContainer::getMethodScope()
+const MethodTable& StackContainer::getMethods()
 {
-	return methodScope;
-}
-
-void StackContainer::addMethods()
-{ // The methods in the method scope are wrappers for the actual hardcoded methods
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return push(args);
-	}), "push", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return pop(args);
-	}), "pop", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return isEmpty(args);
-	}), "isEmpty", true);
+	static const MethodTable methods = {
+		entry<StackContainer, &StackContainer::push>("push"),
+		entry<StackContainer, &StackContainer::pop>("pop"),
+		entry<StackContainer, &StackContainer::isEmpty>("isEmpty")
+	};
+	return methods;
 }
 
 
-QueueContainer::QueueContainer() { addMethods(); };
+QueueContainer::QueueContainer() = default;
 // The queue implementation is very similar to the stack one
 QueueContainer::QueueContainer(const QueueContainer& qc2)
 {
-	copyQueues(queue, qc2.queue);
-	addMethods();
+	copyQueue(qc2);
 }
 
 QueueContainer& QueueContainer::operator=(const QueueContainer& qc2)
 {
-	copyQueues(queue, qc2.queue);
+	if (this != &qc2) copyQueue(qc2);
 	return *this;
 }
 
-QueueContainer::QueueContainer(const std::vector<Object*>& argVec)
+QueueContainer::QueueContainer(Args argVec)
 {
 	if (!argVec.empty()) throw ArgumentError(
 		"Queue constructor does not take any arguments!");
-	addMethods();
 }
 
-void QueueContainer::addMethods()
-{ // Again, wrappers
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return enqueue(args);
-	}), "enqueue", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return dequeue(args);
-	}), "dequeue", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return isEmpty(args);
-	}), "isEmpty", true);
+const MethodTable& QueueContainer::getMethods()
+{
+	static const MethodTable methods = {
+		entry<QueueContainer, &QueueContainer::enqueue>("enqueue"),
+		entry<QueueContainer, &QueueContainer::dequeue>("dequeue"),
+		entry<QueueContainer, &QueueContainer::isEmpty>("isEmpty")
+	};
+	return methods;
 }
 
-Object* QueueContainer::enqueue(const std::vector<Object*>& argVec)
+Object* QueueContainer::enqueue(Args argVec)
 {
 	if (argVec.size() != 1) throw ArgumentError("Exactly 1 argument expected.");
-	// .emplace used since smart pointer is enqueued
-	queue.emplace(std::make_unique<Object>(*argVec[0]));
+	if (count == queue.size()) grow();
+	queue[(head + count) % queue.size()] = std::make_unique<Object>(*argVec[0]);
+	count++;
 	return nullptr;
 }
 
-Object* QueueContainer::dequeue(const std::vector<Object*>& argVec)
+Object* QueueContainer::dequeue(Args argVec)
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	// Check if the queue is empty - if yes throw error
-	if (queue.empty()) throw CustomError("Called dequeue() on empty queue.");
-	const auto poppedObj = new Object(*queue.front());
-	queue.pop();
+	if (count == 0) throw CustomError("Called dequeue() on empty queue.");
+	Object* poppedObj = queue[head].release(); // Moved out, like in pop()
+	head = (head + 1) % queue.size();
+	count--;
 	return poppedObj;
 }
 
-Object* QueueContainer::isEmpty(const std::vector<Object*>& argVec) const
+Object* QueueContainer::isEmpty(Args argVec) const
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
-	return new Object(queue.empty());
+	return new Object(count == 0);
 }
 
-void QueueContainer::copyQueues(QueueType& queue1,
-                                const QueueType& queue2) const
+void QueueContainer::copyQueue(const QueueContainer& qc2)
 {
-	auto& queue2_nonconst = const_cast<QueueType&>(queue2);
-	QueueType tmpQueue;
-	queue1 = QueueType();
-	// A temporary queue is used to refill the initial queue, after everything
-	// has been dequeued and added to the destination queue
-	while (!queue2_nonconst.empty())
+	// The copy starts at the beginning of its buffer, with no room to spare
+	queue.clear();
+	queue.reserve(qc2.count);
+	for (size_t i = 0; i != qc2.count; i++)
 	{
-		// Enqueue dequeued element in both the destination and tmp queue
-		queue1.emplace(std::make_unique<Object>(*queue2_nonconst.front()));
-		tmpQueue.emplace(std::make_unique<Object>(*queue2_nonconst.front()));
-		queue2_nonconst.pop();
-	}
-	while (!tmpQueue.empty())
-	{ // Refill the initial queue
-		queue2_nonconst.emplace(std::make_unique<Object>(*tmpQueue.front()));
-		tmpQueue.pop();
+		queue.emplace_back(std::make_unique<Object>(
+			*qc2.queue[(qc2.head + i) % qc2.queue.size()]));
 	}
+	head = 0;
+	count = qc2.count;
 }
 
-Scope& QueueContainer::getMethodScope()
+void QueueContainer::grow()
 {
-	return methodScope;
+	QueueType buffer(std::max<size_t>(2 * queue.size(), QUEUE_MIN_SIZE));
+	for (size_t i = 0; i != count; i++)
+	{
+		buffer[i] = std::move(queue[(head + i) % queue.size()]);
+	}
+	queue = std::move(buffer);
+	head = 0;
 }
 
-
 CollectionContainer::CollectionContainer()
 {
-	addMethods();
 }
 // Similar constructors for CollectionContainer
 CollectionContainer::CollectionContainer(const CollectionContainer& c)
 {
 	copyCollections(collection, c.collection);
-	addMethods();
 	index = c.index; // The current index must be copied (as the index)
 	// simulates the current state/position of a linked list
 }
@@ -404,45 +650,32 @@ CollectionContainer& CollectionContainer::operator=(
 	return *this;
 }
 
-CollectionContainer::CollectionContainer(const std::vector<Object*>& argVec)
+CollectionContainer::CollectionContainer(Args argVec)
 {
 	if (!argVec.empty()) throw ArgumentError(
 		"Collection constructor does not take any arguments!");
-	addMethods();
 }
 
-void CollectionContainer::addMethods()
-{ // Wrappers for all the container methods
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return addItem(args);
-	}), "addItem", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return hasNext(args);
-	}), "hasNext", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return getNext(args);
-	}), "getNext", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return resetNext(args);
-	}), "resetNext", true);
-	methodScope.addObj(Object([this](const std::vector<Object*>& args)
-	{
-		return isEmpty(args);
-	}), "isEmpty", true);
+const MethodTable& CollectionContainer::getMethods()
+{
+	static const MethodTable methods = {
+		entry<CollectionContainer, &CollectionContainer::addItem>("addItem"),
+		entry<CollectionContainer, &CollectionContainer::hasNext>("hasNext"),
+		entry<CollectionContainer, &CollectionContainer::getNext>("getNext"),
+		entry<CollectionContainer, &CollectionContainer::resetNext>("resetNext"),
+		entry<CollectionContainer, &CollectionContainer::isEmpty>("isEmpty")
+	};
+	return methods;
 }
 
-Object* CollectionContainer::addItem(const std::vector<Object*>& argVec)
+Object* CollectionContainer::addItem(Args argVec)
 { // Add something in the collection
 	if (argVec.size() != 1) throw ArgumentError("Exactly 1 argument expected.");
 	collection.emplace_back(std::make_unique<Object>(*argVec[0]));
 	return nullptr;
 }
 
-Object* CollectionContainer::getNext(const std::vector<Object*>& argVec)
+Object* CollectionContainer::getNext(Args argVec)
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	if (index >= static_cast<int>(collection.size()) - 1) throw CustomError(
@@ -451,20 +684,20 @@ Object* CollectionContainer::getNext(const std::vector<Object*>& argVec)
 	return new Object(*collection[index]);
 }
 
-Object* CollectionContainer::resetNext(const std::vector<Object*>& argVec)
+Object* CollectionContainer::resetNext(Args argVec)
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	index = -1; // Index goes to the beginning
 	return nullptr;
 }
 
-Object* CollectionContainer::hasNext(const std::vector<Object*>& argVec) const
+Object* CollectionContainer::hasNext(Args argVec) const
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	return new Object(index < static_cast<int>(collection.size()) - 1);
 }
 
-Object* CollectionContainer::isEmpty(const std::vector<Object*>& argVec) const
+Object* CollectionContainer::isEmpty(Args argVec) const
 {
 	if (!argVec.empty()) throw ArgumentError("No arguments expected.");
 	return new Object(collection.empty());
@@ -481,50 +714,128 @@ void CollectionContainer::copyCollections(CollectionType& c1,
 	}
 }
 
-Scope& CollectionContainer::getMethodScope()
-{
-	return methodScope;
-}
-
-
 Function::Function(CodeBlock* block, std::vector<ASTNode*> params,
-                   const int level) : block(block),
-                                      paramVec(std::move(params)),
-                                      definedFuncLevel(level)
+                   const int level, const Proto* proto, const StmtClosure* body) :
+	block(block), paramVec(std::move(params)), definedFuncLevel(level), proto(proto),
+	body(body)
 {
 };
 
 Function::Function() = default;
 
-Object* Function::eval(Scope* scope, const std::vector<Object*>& argVec) const
+Object* Function::eval(Scope* scope, Args argVec) const
+{
+	bindArgs(scope, argVec);
+	// Run block, as a closure if the function was defined by one
+	Object* funcResult = (body) ? ((*body)(scope, true)) : (block->eval(scope, true));
+
+	if (funcResult == nullptr) funcResult = new Object; /* We must avoid
+	returning null pointers since it will create fatal errors */
+
+	scope->exitFunction(); /* Restore levels */
+	return funcResult;
+}
+
+void Function::bindArgs(Scope* scope, Args argVec) const
 {
 	// Check if number of parameters passed is appropriate
 	if (argVec.size() != paramVec.size())
 		throw ArgumentError(
 			"Number of arguments not equal to number of declared parameters.");
 
-	// Get the scope that will be passed to the function body
-	Scope* newScope = scope->getRestricted(definedFuncLevel);
-
-	// Levels must be increased (both of them)
-	newScope->incLevel();
-	newScope->incFuncLevel();
+	// The function's frame is linked to the variables it can access
+	scope->enterFunction(definedFuncLevel, paramVec.size());
 
-	Object* funcResult = nullptr; // Return value
+	Object unused; // The parameters are variables, not temporaries
 	for (size_t i = 0; i != argVec.size(); i++)
 	{ /* Create variable argument objects in function's scope, initialize them
 		 with the passed argument values */
-		*paramVec[i]->eval(newScope, true) = *argVec[i];
+		*paramVec[i]->eval(scope, unused, true) = *argVec[i];
 	}
-	funcResult = block->eval(newScope, true); // Run block
+}
 
-	if (funcResult == nullptr) funcResult = new Object; /* We must avoid
-	returning null pointers since it will create fatal errors */
+const Proto* Function::getProto() const { return proto; }
 
-	newScope->decrLevel(); /* Restore levels */
-	newScope->decrFuncLevel();
-	delete newScope; /*Destroy function's scope */
-	return funcResult;
+Method findMethod(Object& receiver, const std::string& name)
+{
+	Method method = nullptr;
+	std::visit(overload{
+		           [&method, &name](Ref<StackContainer>&)
+		           {
+			           method = lookupMethod(StackContainer::getMethods(), name);
+		           },
+		           [&method, &name](Ref<QueueContainer>&)
+		           {
+			           method = lookupMethod(QueueContainer::getMethods(), name);
+		           },
+		           [&method, &name](Ref<ArrayContainer>&)
+		           {
+			           method = lookupMethod(ArrayContainer::getMethods(), name);
+		           },
+		           [&method, &name](Ref<CollectionContainer>&)
+		           {
+			           method = lookupMethod(CollectionContainer::getMethods(), name);
+		           },
+		           [&method, &name](Ref<StringContainer>&)
+		           {
+			           method = lookupMethod(StringContainer::getMethods(), name);
+		           },
+		           [](auto&)
+		           {
+			           throw TypeError("Object does not contain methods.");
+		           }
+	           }, receiver.data);
+	return method;
+}
+
+bool isModifyingMethod(const std::string& name)
+{
+	for (const MethodTable* methods : {
+		     &ArrayContainer::getMethods(), &StringContainer::getMethods(),
+		     &StackContainer::getMethods(), &QueueContainer::getMethods(),
+		     &CollectionContainer::getMethods()
+	     })
+	{
+		for (const MethodEntry& entry : *methods)
+		{
+			if (entry.name == name && entry.modifies) return true;
+		}
+	}
+	return false;
+}
+
+std::vector<WriteLocks::Lock> WriteLocks::locks{};
+
+void WriteLocks::unlockAfter(const size_t mark)
+{
+	while (locks.size() > mark)
+	{
+		const Lock lock = locks.back();
+		locks.pop_back();
+		lock.unlock(lock.box);
+	}
+}
+
+ExternalFunction bindMethod(Object& receiver, const Method method)
+{
+	// The method changes the container it was taken from, so that container is no
+	// longer shared with other objects
+	receiver.unshare();
+	std::visit(overload{
+		           [](Ref<StackContainer>& sc) { sc.pin(); },
+		           [](Ref<QueueContainer>& qc) { qc.pin(); },
+		           [](Ref<ArrayContainer>& ac) { ac.pin(); },
+		           [](Ref<CollectionContainer>& cc) { cc.pin(); },
+		           [](Ref<StringContainer>& sc) { sc.pin(); },
+		           [](auto&)
+		           {
+		           }
+	           }, receiver.data);
+	return [container = receiver.data, method](Args args)
+	{
+		Object bound(container);
+		return method(bound, args);
+	};
 }
 
 Object::Object() = default;
@@ -534,6 +845,24 @@ Object::Object(const Object& obj2)
 	*this = obj2; // Copy object to another
 }
 
+Object::Object(Function func) : data(makeRef<Function>(std::move(func)))
+{
+}
+
+Object::Object(ExternalFunction func) : data(makeRef<ExternalFunction>(std::move(func)))
+{
+}
+
+void* Object::operator new(const size_t size)
+{
+	return Pool::allocate(size);
+}
+
+void Object::operator delete(void* ptr, const size_t size)
+{
+	Pool::deallocate(ptr, size);
+}
+
 bool Object::isLval() const
 {
 	return lval;
@@ -577,7 +906,7 @@ std::string Object::toStr()
 			           tmpS.erase(tmpS.find_last_not_of("0") + 1);
 			           result = tmpS;
 		           },
-		           [&result](std::shared_ptr<StringContainer> sc)
+		           [&result](Ref<StringContainer> sc)
 		           {
 			           result = sc->getStr(); // Get string of StringContainer
 		           },
@@ -597,6 +926,42 @@ bool Object::isPersistentType() const
 	return persistentType;
 }
 
+Object& Object::makeProxy(const PackedContainer container, const size_t index)
+{
+	PendingStore& pending = pendingStores.emplace_back();
+	pending.proxy.setLval(true);
+	pending.proxy.proxy = true;
+	pending.container = container;
+	pending.index = index;
+	return pending.proxy;
+}
+
+bool Object::isProxy() const
+{
+	return proxy;
+}
+
+void Object::storeBack()
+{
+	if (!proxy) return;
+	// Proxies given after this one and not stored back (i.e. because of an error) are
+	// dropped
+	while (!pendingStores.empty())
+	{
+		PendingStore& pending = pendingStores.back();
+		const bool isThis = &pending.proxy == this;
+		if (isThis)
+		{
+			std::visit([&pending](auto* container)
+			{
+				container->store(pending.index, pending.proxy);
+			}, pending.container);
+		}
+		pendingStores.pop_back();
+		if (isThis) return;
+	}
+}
+
 bool Object::isConst() const
 {
 	return constness;
@@ -9,6 +9,20 @@ struct overload : Ts...
 	using Ts::operator()...;
 };
 
+// A pinned or locked container is copied right away instead
+template <typename C>
+static Ref<C> share(const Ref<C>& container)
+{
+	return (container.isPinned() || container.isLocked())
+		       ? (makeRef<C>(*container))
+		       : (container);
+}
+
+template <typename C>
+static void unshareRef(Ref<C>& container)
+{
+	if (container.isShared()) container = makeRef<C>(*container);
+}
 
 static VariantType cast_to_str(VariantType& var)
 // Converts anything to a string
@@ -29,7 +43,7 @@ static VariantType cast_to_str(VariantType& var)
 			           tmpS.erase(tmpS.find_last_not_of("0") + 1);
 			           result = StringContainer(tmpS);
 		           },
-		           [&result](std::shared_ptr<StringContainer> sc)
+		           [&result](Ref<StringContainer> sc)
 		           {
 			           result = StringContainer(*sc); // Get string of StringContainer
 		           },
@@ -39,7 +53,7 @@ static VariantType cast_to_str(VariantType& var)
 				           "Object does not have a string representation");
 		           }
 	           }, var);
-	return VariantType(std::make_shared<StringContainer>(result));
+	return VariantType(makeRef<StringContainer>(result));
 }
 
 static VariantType cast_to_char(VariantType& var) // We can't go lower than char
@@ -231,31 +245,16 @@ Object& Object::operator=(const Object& obj2)
 		           [this](char& i) { data = i; },
 		           [this](float& i) { data = i; },
 		           [this](int& i) { data = i; },
-		           [this](Function& i) { data = i; },
-		           [this](ExternalFunction& i) { data = i; },
-				   // Containers are in fact pointers to containers. Instead of copying
-				   // the pointer, we should instantiate another object that is a copy of
-				   // the one pointed by the pointer
-		           [this](std::shared_ptr<StackContainer>& sc)
-		           {
-			           data = std::make_shared<StackContainer>(*sc);
-		           },
-		           [this](std::shared_ptr<ArrayContainer>& ac)
-		           {
-			           data = std::make_shared<ArrayContainer>(*ac);
-		           },
-		           [this](std::shared_ptr<QueueContainer>& qc)
-		           {
-			           data = std::make_shared<QueueContainer>(*qc);
-		           },
-		           [this](std::shared_ptr<CollectionContainer>& cc)
-		           {
-			           data = std::make_shared<CollectionContainer>(*cc);
-		           },
-		           [this](std::shared_ptr<StringContainer>& sc)
-		           {
-			           data = std::make_shared<StringContainer>(*sc);
-		           },
+		           // Functions can't be modified, so they're shared
+		           [this](Ref<Function>& i) { data = i; },
+		           [this](Ref<ExternalFunction>& i) { data = i; },
+				   // Containers are in fact pointers to containers. The pointer is copied,
+				   // and the container is shared until one of the objects changes it.
+		           [this](Ref<StackContainer>& sc) { data = share(sc); },
+		           [this](Ref<ArrayContainer>& ac) { data = share(ac); },
+		           [this](Ref<QueueContainer>& qc) { data = share(qc); },
+		           [this](Ref<CollectionContainer>& cc) { data = share(cc); },
+		           [this](Ref<StringContainer>& sc) { data = share(sc); },
 		           [](auto&)
 		           {
 		           }
@@ -266,18 +265,27 @@ Object& Object::operator=(const Object& obj2)
 
 Object& Object::operator+=(Object& rhs)
 {
+	if (std::holds_alternative<Ref<StringContainer>>(data) && !isConst())
+	{
+		// A string is appended to in place (see StringContainer). I.e. let s = "a",
+		// then s += 5 yields s == "a5"
+		const VariantType varR = cast_to_str(rhs.data);
+		unshare();
+		std::get<Ref<StringContainer>>(data)->append(
+			std::get<Ref<StringContainer>>(varR)->getStr());
+	}
 	// If either one holds a string
-	if (std::holds_alternative<std::shared_ptr<StringContainer>>(data) ||
-		std::holds_alternative<std::shared_ptr<StringContainer>>(rhs.data))
+	else if (std::holds_alternative<Ref<StringContainer>>(data) ||
+		std::holds_alternative<Ref<StringContainer>>(rhs.data))
 	{
 		VariantType varL, varR;
 		varL = cast_to_str(data); // Convert both to string
 		varR = cast_to_str(rhs.data);
 		// Result is a string that is the combination of the two operands
 		// I.e. let a = 5, then a += "hello" yields a == "5hello", since 5 casts to "5"
-		*this = Object(std::make_shared<StringContainer>(
-			std::get<std::shared_ptr<StringContainer>>(varL)->getStr() +
-			std::get<std::shared_ptr<StringContainer>>(varR)->getStr()));
+		std::get<Ref<StringContainer>>(varL)->append(
+			std::get<Ref<StringContainer>>(varR)->getStr());
+		*this = Object(varL);
 	}
 	else
 	{
@@ -431,11 +439,11 @@ Object operator<(Object& lhs, Object& rhs)
 {
 	VariantType varL = lhs.data, varR = rhs.data;
 	Object result;
-	if (std::holds_alternative<std::shared_ptr<StringContainer>>(varL) &&
-		std::holds_alternative<std::shared_ptr<StringContainer>>(varR))
+	if (std::holds_alternative<Ref<StringContainer>>(varL) &&
+		std::holds_alternative<Ref<StringContainer>>(varR))
 		// Strings can be compared too
-		result.data = std::get<std::shared_ptr<StringContainer>>(varL)->getStr()
-			< std::get<std::shared_ptr<StringContainer>>(varR)->getStr();
+		result.data = std::get<Ref<StringContainer>>(varL)->getStr()
+			< std::get<Ref<StringContainer>>(varR)->getStr();
 		// Lexicographical comparison
 	else
 		result.data = numericalOperator(varL, varR, [](auto& x, auto& y)
@@ -465,10 +473,10 @@ Object operator==(Object& lhs, Object& rhs)
 	VariantType varL = lhs.data, varR = rhs.data;
 	Object result;
 	// Acount for strings just like in < operator
-	if (std::holds_alternative<std::shared_ptr<StringContainer>>(varL) &&
-		std::holds_alternative<std::shared_ptr<StringContainer>>(varR))
-		result.data = std::get<std::shared_ptr<StringContainer>>(varL)->getStr()
-			== std::get<std::shared_ptr<StringContainer>>(varR)->getStr();
+	if (std::holds_alternative<Ref<StringContainer>>(varL) &&
+		std::holds_alternative<Ref<StringContainer>>(varR))
+		result.data = std::get<Ref<StringContainer>>(varL)->getStr()
+			== std::get<Ref<StringContainer>>(varR)->getStr();
 	else
 		result.data = numericalOperator(varL, varR, [](auto& x, auto& y)
 		{
@@ -498,38 +506,59 @@ Object operator&&(Object& lhs, Object& rhs)
 }
 
 
-Object* Object::operator()(Scope* scope, const std::vector<Object*>& argVec)
+Object* Object::operator()(Scope* scope, Args argVec)
 {
 	Object* result = nullptr;
 	std::visit(overload{
 		           // Function call operator
-		           [&result, &scope, &argVec](Function& func)
+		           [&result, &scope, &argVec](Ref<Function>& func)
 		           { // Pass scope and argument vector
-			           result = func.eval(scope, argVec);
+			           result = func->eval(scope, argVec);
 		           },
-		           [&result, &argVec](ExternalFunction& external_function)
+		           [&result, &argVec](Ref<ExternalFunction>& external_function)
 		           {
-			           result = external_function(argVec);
+			           result = (*external_function)(argVec);
 		           },
 		           [](auto&) { throw TypeError("Not a callable object."); }
 	           }, this->data);
 	return result;
 }
 
-Object* Object::operator[](const std::vector<Object*>& indexVec)
+Object* Object::getElement(Args indexVec, Object& tmp)
 {
 	// This is the subscript operator that only acts on arrays and strings.
 	Object* result = nullptr;
 	std::visit(overload{
-		           [&result, &indexVec](
-		           std::shared_ptr<ArrayContainer>& array_container)
+		           [&result, &indexVec, &tmp](
+		           Ref<ArrayContainer>& array_container)
 		           { // indexVec holds the index (or indices for multi dim. arrays)
-			           result = array_container->getArray(indexVec);
+			           result = array_container->getArray(indexVec, tmp);
 		           },
-		           [&result, &indexVec](
-		           std::shared_ptr<StringContainer>& string_container)
+		           [&result, &indexVec, &tmp](
+		           Ref<StringContainer>& string_container)
 		           { // Same with strings
-			           result = string_container->getChar(indexVec);
+			           result = string_container->getChar(indexVec, tmp);
+		           },
+		           [](auto&)
+		           {
+			           throw TypeError("Object does not accept a subscript.");
+		           }
+	           }, this->data);
+	return result;
+}
+
+Object* Object::getWritable(Args indexVec)
+{
+	prepareWrite(); // Other objects holding the container must not see the change
+	Object* result = nullptr;
+	std::visit(overload{
+		           [&result, &indexVec](Ref<ArrayContainer>& array_container)
+		           {
+			           result = array_container->getWritable(indexVec);
+		           },
+		           [&result, &indexVec](Ref<StringContainer>& string_container)
+		           {
+			           result = string_container->getWritable(indexVec);
 		           },
 		           [](auto&)
 		           {
@@ -538,3 +567,32 @@ Object* Object::operator[](const std::vector<Object*>& indexVec)
 	           }, this->data);
 	return result;
 }
+
+void Object::unshare()
+{
+	std::visit(overload{
+		           [](Ref<StackContainer>& sc) { unshareRef(sc); },
+		           [](Ref<ArrayContainer>& ac) { unshareRef(ac); },
+		           [](Ref<QueueContainer>& qc) { unshareRef(qc); },
+		           [](Ref<CollectionContainer>& cc) { unshareRef(cc); },
+		           [](Ref<StringContainer>& sc) { unshareRef(sc); },
+		           [](auto&)
+		           {
+		           }
+	           }, data);
+}
+
+void Object::prepareWrite()
+{
+	unshare();
+	std::visit(overload{
+		           [](Ref<StackContainer>& sc) { WriteLocks::lock(sc); },
+		           [](Ref<ArrayContainer>& ac) { WriteLocks::lock(ac); },
+		           [](Ref<QueueContainer>& qc) { WriteLocks::lock(qc); },
+		           [](Ref<CollectionContainer>& cc) { WriteLocks::lock(cc); },
+		           [](Ref<StringContainer>& sc) { WriteLocks::lock(sc); },
+		           [](auto&)
+		           {
+		           }
+	           }, data);
+}
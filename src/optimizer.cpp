@@ -0,0 +1,261 @@
+/* optimizer.cpp */
+
+#include "optimizer.h"
+#include "AST.h"
+#include "constants.h"
+#include "errors.h"
+#include <algorithm>
+#include <climits>
+
+Optimizer::Optimizer(const Scope& globalScope, Arena& arena, ConstantPool& pool) :
+	globalScope(globalScope), arena(arena), pool(pool)
+{
+}
+
+void Optimizer::optimize(CodeBlock* mainBlock)
+{
+	mainBlock->fold(*this); // Fold the constants and count the assignments
+	propagating = true;
+	mainBlock->fold(*this); // Propagate the constant variables and fold again
+}
+
+void Optimizer::enterBlock() { blockDepth++; }
+void Optimizer::exitBlock() { blockDepth--; }
+void Optimizer::enterFunction() { functionDepth++; }
+void Optimizer::exitFunction() { functionDepth--; }
+void Optimizer::setRoot(const ASTNode* node) { root = node; }
+bool Optimizer::isRoot(const ASTNode* node) const { return node == root; }
+
+static bool isLiteral(const ASTNode* node)
+{
+	return dynamic_cast<const LiteralNode*>(node) != nullptr;
+}
+
+// Whether the literal is an int, char or bool, whose value is then put in value
+static bool getIntegral(const ASTNode* node, long long& value)
+{
+	const VariantType& data = static_cast<const LiteralNode*>(node)->getValue().data;
+	if (const int* i = std::get_if<int>(&data)) value = *i;
+	else if (const char* c = std::get_if<char>(&data)) value = *c;
+	else if (const bool* b = std::get_if<bool>(&data)) value = *b;
+	else return false;
+	return true;
+}
+
+/* An integer division by zero, or of INT_MIN by -1, doesn't throw: it kills the
+ * process. Such literals are left unfolded, the code may never run. */
+static bool mayTrap(const OperatorType opType, const ASTNode* left, const ASTNode* right)
+{
+	if (opType != OperatorType::DIVISION && opType != OperatorType::MODULO &&
+		opType != OperatorType::DIV)
+		return false;
+	long long divisor = 0, dividend = 0;
+	if (!getIntegral(right, divisor)) return false;
+	if (divisor == 0) return true;
+	return divisor == -1 && getIntegral(left, dividend) && dividend == INT_MIN;
+}
+
+void Optimizer::addWrite(const ASTNode* target)
+{
+	if (propagating) return; // Already counted
+	if (const auto* idNode = dynamic_cast<const IDNode*>(target))
+		writes[idNode->getID()]++;
+}
+
+void Optimizer::define(const ASTNode* target, const ASTNode* value)
+{
+	// Only an assignment in the main block surely runs once, before what follows it
+	if (!propagating || blockDepth != 1 || functionDepth != 0) return;
+	const auto* idNode = dynamic_cast<const IDNode*>(target);
+	const auto* literal = dynamic_cast<const LiteralNode*>(value);
+	if (!idNode || !literal) return;
+	const std::string& id = idNode->getID();
+	// The hardcoded objects are constant, the assignment fails
+	if (writes[id] != 1 || globalScope.getSlot(id, 0) >= 0) return;
+	const VariantType& data = literal->getValue().data;
+	// Containers can be modified through their elements
+	if (std::holds_alternative<int>(data) || std::holds_alternative<float>(data) ||
+		std::holds_alternative<bool>(data) || std::holds_alternative<char>(data))
+		constants[id] = literal;
+}
+
+bool Optimizer::isPureCallee(const ASTNode* callee) const
+{
+	if (const auto* idNode = dynamic_cast<const IDNode*>(callee))
+	{
+		const std::string& id = idNode->getID();
+		return id != "input" && globalScope.getSlot(id, 0) >= 0;
+	}
+	return callee->isMethod(); // The methods copy their arguments
+}
+
+ASTNode* Optimizer::evaluate(ASTNode* node)
+{
+	try
+	{
+		Object tmp;
+		if (const Object* result = node->eval(&emptyScope, tmp))
+			return arena.make<LiteralNode>(pool.intern(*result), node->getPos());
+	}
+	catch (CustomError&)
+	{
+		// I.e. 1 / 0 must still throw when (and if) it runs
+	}
+	return node;
+}
+
+ASTNode* Optimizer::propagate(IDNode* node)
+{
+	if (!propagating) return node;
+	const auto itr = constants.find(node->getID());
+	if (itr == constants.end()) return node;
+	return arena.make<LiteralNode>(&itr->second->getValue(), node->getPos());
+}
+
+void CodeBlock::fold(Optimizer& optimizer)
+{
+	optimizer.enterBlock();
+	for (Statement* st : statementVec)
+	{
+		st->fold(optimizer);
+	}
+	optimizer.exitBlock();
+}
+
+void Statement::fold(Optimizer&)
+{
+}
+
+void IfStatement::fold(Optimizer& optimizer)
+{
+	for (auto& [casePtr, blockPtr] : cases)
+	{
+		casePtr = casePtr->fold(optimizer);
+		blockPtr->fold(optimizer);
+	}
+}
+
+void WhileStatement::fold(Optimizer& optimizer)
+{
+	condition = condition->fold(optimizer);
+	block->fold(optimizer);
+}
+
+void ForStatement::fold(Optimizer& optimizer)
+{
+	lowerNode = lowerNode->fold(optimizer);
+	upperNode = upperNode->fold(optimizer);
+	optimizer.addWrite(counterNode);
+	block->fold(optimizer);
+}
+
+void ExprStatement::fold(Optimizer& optimizer)
+{
+	optimizer.setRoot(exprRoot); // An assignment at the root may define a constant
+	exprRoot = exprRoot->fold(optimizer);
+}
+
+void ReturnStatement::fold(Optimizer& optimizer)
+{
+	returnRoot = returnRoot->fold(optimizer);
+}
+
+void FunctionDefStatement::fold(Optimizer& optimizer)
+{
+	optimizer.addWrite(funcID);
+	for (const ASTNode* param : funcParams)
+	{
+		optimizer.addWrite(param);
+	}
+	optimizer.enterFunction();
+	block->fold(optimizer);
+	optimizer.exitFunction();
+}
+
+ASTNode* ASTNode::fold(Optimizer&)
+{
+	return this;
+}
+
+ASTNode* nAryNode::fold(Optimizer& optimizer)
+{
+	// The hardcoded functions get the arguments themselves, i.e. input(a) assigns to a.
+	// Any function may be input, unless it is another hardcoded one or a method.
+	const bool mayWrite = opType == OperatorType::FUNCTION_CALL &&
+		!optimizer.isPureCallee(mainOperand);
+	for (ASTNode*& node : nOperands)
+	{
+		if (mayWrite && dynamic_cast<IDNode*>(node)) optimizer.addWrite(node);
+		else node = node->fold(optimizer);
+	}
+	if (mainOperand) mainOperand = mainOperand->fold(optimizer);
+	if (opType == OperatorType::LIST_INIT && std::all_of(nOperands.begin(),
+		nOperands.end(), isLiteral))
+		return optimizer.evaluate(this); // I.e. [N - 1, 0]
+	return this;
+}
+
+ASTNode* BinaryNode::fold(Optimizer& optimizer)
+{
+	switch (opType)
+	{
+	case OperatorType::MEMBER_ACCESS: // The method name isn't a variable
+		left = left->fold(optimizer);
+		return this;
+	case OperatorType::ASSIGNMENT:
+	case OperatorType::ADDITION_ASSIGN:
+	case OperatorType::SUBTRACTION_ASSIGN:
+	case OperatorType::MULTIPLICATION_ASSIGN:
+	case OperatorType::DIVISION_ASSIGN:
+	case OperatorType::MODULO_ASSIGN:
+	case OperatorType::DIV_ASSIGN:
+		{
+			const bool isRoot = optimizer.isRoot(this);
+			optimizer.addWrite(left);
+			// A variable assigned to is kept, but i.e. the index in A[N - 1] is folded
+			if (!dynamic_cast<IDNode*>(left)) left = left->fold(optimizer);
+			right = right->fold(optimizer);
+			if (opType == OperatorType::ASSIGNMENT && isRoot)
+				optimizer.define(left, right);
+			return this;
+		}
+	case OperatorType::COMMA:
+		left = left->fold(optimizer);
+		right = right->fold(optimizer);
+		return this;
+	default:
+		left = left->fold(optimizer);
+		right = right->fold(optimizer);
+		if (isLiteral(left) && isLiteral(right) && !mayTrap(opType, left, right))
+			return optimizer.evaluate(this);
+		return this;
+	}
+}
+
+ASTNode* UnaryNode::fold(Optimizer& optimizer)
+{
+	switch (opType)
+	{
+	case OperatorType::PRE_INCR:
+	case OperatorType::PRE_DECR:
+	case OperatorType::POST_INCR:
+	case OperatorType::POST_DECR:
+		optimizer.addWrite(operand);
+		if (!dynamic_cast<IDNode*>(operand)) operand = operand->fold(optimizer);
+		return this;
+	default:
+		operand = operand->fold(optimizer);
+		if (isLiteral(operand)) return optimizer.evaluate(this);
+		return this;
+	}
+}
+
+ASTNode* LiteralNode::fold(Optimizer&)
+{
+	return this;
+}
+
+ASTNode* IDNode::fold(Optimizer& optimizer)
+{
+	return optimizer.propagate(this);
+}
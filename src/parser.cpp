@@ -6,7 +6,7 @@
 
 Parser::Parser() = default;
 
-CodeBlock* Parser::getAST(const std::string& inputStr)
+Program Parser::getAST(const std::string& inputStr)
 {
 	// Returns full AST based on inputStr
 	lexer.setInput(inputStr); // Convert str to tokens
@@ -18,7 +18,14 @@ CodeBlock* Parser::getAST(const std::string& inputStr)
 		// If there are unparsed characters in the end, something's wrong
 		throw ParsingError("", lexer.getCurrToken().getPos());
 	}
-	return mainBlock;
+	// The nodes are handed over with the arena. If parsing fails, the parser frees them
+	return {std::move(arena), std::move(constants), mainBlock};
+}
+
+template <typename T>
+ASTNode* Parser::makeLiteral(const T& val, const size_t pos)
+{
+	return arena.make<LiteralNode>(constants.intern(Object(val)), pos);
 }
 
 // Note: (this->*(currGroup + 1)->parserFunc)(currGroup + 1) calls the appropriate parser
@@ -37,7 +44,7 @@ CodeBlock* Parser::parseBlock()
 {
 	blockLevel++; // New block => level up
 	// Used to know how many tabs to expect in the current block
-	const auto currBlock = new CodeBlock();
+	const auto currBlock = arena.make<CodeBlock>();
 	while (lexer.getCurrToken().getType() != Lexer::TokenType::EOFILE)
 	{
 		// A block is defined by statements having equal indentation.
@@ -109,7 +116,7 @@ Statement* Parser::parseReturn()
 	// pos always holds the position of the statement/operator/expression and is stored
 	// for error reporting
 	lexer.scanToken();
-	Statement* returnStatement = new ReturnStatement(
+	Statement* returnStatement = arena.make<ReturnStatement>(
 		(this->*precedenceTab[0].parserFunc)(precedenceTab), pos);
 	checkNewLine(); // Proceeds to new line - if more code in same line throw error
 	return returnStatement;
@@ -119,7 +126,7 @@ Statement* Parser::parseExpr()
 // Simply parses an expression and returns the result 
 {
 	const size_t pos = lexer.getCurrToken().getPos();
-	Statement* exprStatement = new ExprStatement(
+	Statement* exprStatement = arena.make<ExprStatement>(
 		(this->*precedenceTab[0].parserFunc)(precedenceTab), pos);
 	checkNewLine(); // Go to next line
 	return exprStatement;
@@ -127,7 +134,7 @@ Statement* Parser::parseExpr()
 
 Statement* Parser::parseIf()
 {
-	const auto statement = new IfStatement(lexer.getCurrToken().getPos());
+	const auto statement = arena.make<IfStatement>(lexer.getCurrToken().getPos());
 	Lexer::TokenType currToken;
 	while ((currToken = lexer.getCurrToken().getType()) == Lexer::TokenType::IF
 		|| currToken ==
@@ -153,7 +160,7 @@ Statement* Parser::parseIf()
 		}
 		else
 		{
-			condition = new LiteralNode(true, 0);
+			condition = makeLiteral(true, 0);
 			// Create a dummy condition that is always true
 		}
 
@@ -194,7 +201,7 @@ Statement* Parser::parseWhile()
 	checkNewLine();
 	CodeBlock* block = parseBlock(); // Get the block
 
-	return new WhileStatement(condition, block, pos);
+	return arena.make<WhileStatement>(condition, block, pos);
 }
 
 Statement* Parser::parseFor()
@@ -205,7 +212,7 @@ Statement* Parser::parseFor()
 	if (lexer.getCurrToken().getType() != Lexer::TokenType::ID)
 		throw ParsingError("Token is not an identifier.",
 		                   lexer.getCurrToken().getPos());
-	ASTNode* counterNode = new IDNode(lexer.getCurrToken().getLexeme(),
+	ASTNode* counterNode = arena.make<IDNode>(lexer.getCurrToken().getLexeme(),
 	                                  lexer.getCurrToken().getPos());
 	lexer.scanToken();
 
@@ -234,7 +241,7 @@ Statement* Parser::parseFor()
 
 	CodeBlock* block = parseBlock(); // Parse 'for' block
 
-	return new ForStatement(counterNode, lowerNode, upperNode, block, pos);
+	return arena.make<ForStatement>(counterNode, lowerNode, upperNode, block, pos);
 }
 
 ASTNode* Parser::parseUnary(precedenceGroup* currGroup)
@@ -247,7 +254,7 @@ ASTNode* Parser::parseUnary(precedenceGroup* currGroup)
 		const size_t pos = lexer.getCurrToken().getPos();
 		lexer.scanToken(); // Proceed to next token
 		ASTNode* child = parseUnary(currGroup); // E -> [op]E
-		return new UnaryNode(child, currGroup->findOp[currToken], pos);
+		return arena.make<UnaryNode>(child, currGroup->findOp[currToken], pos);
 		// Create unary node, assign the corresponding operator
 	}
 	return (this->*(currGroup + 1)->parserFunc)(currGroup + 1); // E -> T
@@ -268,7 +275,7 @@ ASTNode* Parser::parseBinLeft(precedenceGroup* currGroup)
 			lexer.scanToken();
 			ASTNode* nodeB = (this->*(currGroup + 1)->
 				parserFunc)(currGroup + 1); // Get right operand
-			ASTNode* tmpNode = new BinaryNode(nodeA, nodeB,
+			ASTNode* tmpNode = arena.make<BinaryNode>(nodeA, nodeB,
 			                                  currGroup->findOp[currToken],
 			                                  pos);
 			// Use temporary node to fix left recursion problem
@@ -292,7 +299,8 @@ ASTNode* Parser::parseBinRight(precedenceGroup* currGroup)
 		lexer.scanToken();
 		ASTNode* nodeB = (this->*(currGroup)->parserFunc)(currGroup);
 		// E -> T + E (call E again)
-		return new BinaryNode(nodeA, nodeB, currGroup->findOp[currToken], pos);
+		return arena.make<BinaryNode>(nodeA, nodeB, currGroup->findOp[currToken],
+		                              pos);
 	}
 	return nodeA;
 }
@@ -340,7 +348,7 @@ ASTNode* Parser::parseParenthAndDot(precedenceGroup* currGroup)
 			}
 			else lexer.scanToken(2);
 			// If we have "()", just skip both parentheses
-			node = new nAryNode(node, currGroup->findOp[currToken], nOperands,
+			node = arena.make<nAryNode>(node, currGroup->findOp[currToken], nOperands,
 			                    pos);
 		}
 		else if (lexer.getCurrToken().getType() == Lexer::TokenType::DOT)
@@ -350,7 +358,7 @@ ASTNode* Parser::parseParenthAndDot(precedenceGroup* currGroup)
 			lexer.scanToken();
 			ASTNode* nodeB = (this->*(currGroup + 1)->
 				parserFunc)(currGroup + 1);
-			ASTNode* tmpNode = new BinaryNode(node, nodeB,
+			ASTNode* tmpNode = arena.make<BinaryNode>(node, nodeB,
 			                                  OperatorType::MEMBER_ACCESS, pos);
 			node = tmpNode;
 		}
@@ -370,7 +378,7 @@ Statement* Parser::parseFunctionDef()
 		throw ParsingError("Token is not an identifier.",
 		                   lexer.getCurrToken().getPos());
 	// Store the node
-	ASTNode* funcIdNode = new IDNode(lexer.getCurrToken().getLexeme(),
+	ASTNode* funcIdNode = arena.make<IDNode>(lexer.getCurrToken().getLexeme(),
 	                                 lexer.getCurrToken().getPos());
 	lexer.scanToken();
 
@@ -388,7 +396,7 @@ Statement* Parser::parseFunctionDef()
 			if (lexer.getCurrToken().getType() != Lexer::TokenType::ID)
 				throw ParsingError("Token is not an identifier.",
 				                   lexer.getCurrToken().getPos());
-			paramVec.push_back(new IDNode(lexer.getCurrToken().getLexeme(),
+			paramVec.push_back(arena.make<IDNode>(lexer.getCurrToken().getLexeme(),
 			                              lexer.getCurrToken().getPos()));
 			lexer.scanToken();
 		}
@@ -404,7 +412,7 @@ Statement* Parser::parseFunctionDef()
 	lexer.scanToken();
 	checkNewLine();
 	CodeBlock* block = parseBlock(); // This is the actual function code
-	return new FunctionDefStatement(funcIdNode, paramVec, block, pos);
+	return arena.make<FunctionDefStatement>(funcIdNode, paramVec, block, pos);
 }
 
 
@@ -422,7 +430,7 @@ ASTNode* Parser::parseUnaryPostfix(precedenceGroup* currGroup)
 			const size_t pos = lexer.getCurrToken().getPos();
 			lexer.scanToken();
 			// Old node becomes child
-			node = new UnaryNode(node, currGroup->findOp[currToken], pos);
+			node = arena.make<UnaryNode>(node, currGroup->findOp[currToken], pos);
 		}
 		else
 			return node;
@@ -466,33 +474,30 @@ ASTNode* Parser::parsePrimary(precedenceGroup*)
 	switch (lexer.getCurrToken().getType())
 	{ // Create a node and load it according to the token's lexeme
 	case Lexer::TokenType::TRUE_LIT:
-		node = new LiteralNode(true, pos);
+		node = makeLiteral(true, pos);
 		lexer.scanToken();
 		break;
 	case Lexer::TokenType::FALSE_LIT:
-		node = new LiteralNode(false, pos);
+		node = makeLiteral(false, pos);
 		lexer.scanToken();
 		break;
 	case Lexer::TokenType::INT_LIT: // If number literal, convert lexeme to int
-		node = new LiteralNode(std::stoi(lexer.getCurrToken().getLexeme()),
-		                       pos);
+		node = makeLiteral(std::stoi(lexer.getCurrToken().getLexeme()), pos);
 		lexer.scanToken();
 		break;
 	case Lexer::TokenType::FLOAT_LIT:
 		// If number literal, convert lexeme to int
-		node = new LiteralNode(std::stof(lexer.getCurrToken().getLexeme()),
-		                       pos);
+		node = makeLiteral(std::stof(lexer.getCurrToken().getLexeme()), pos);
 		lexer.scanToken();
 		break;
 	case Lexer::TokenType::CHAR_LIT: // If number literal, convert lexeme to int
-		node = new LiteralNode(lexer.getCurrToken().getLexeme()[0], pos);
+		node = makeLiteral(lexer.getCurrToken().getLexeme()[0], pos);
 		lexer.scanToken();
 		break;
 
 	case Lexer::TokenType::STRING_LIT:
-		node = new LiteralNode( // Strings are saved in StringContainers
-			std::make_shared<StringContainer>(lexer.getCurrToken().getLexeme()),
-			pos);
+		node = makeLiteral( // Strings are saved in StringContainers
+			makeRef<StringContainer>(lexer.getCurrToken().getLexeme()), pos);
 		lexer.scanToken();
 		break;
 	case Lexer::TokenType::L_PAREN:
@@ -517,11 +522,10 @@ ASTNode* Parser::parsePrimary(precedenceGroup*)
 		}
 		break;
 	case Lexer::TokenType::L_SQ_BRACKET:
-		node = new nAryNode(nullptr, OperatorType::LIST_INIT, listParser(),
-		                    pos);
+		node = makeList(listParser(), pos);
 		break;
 	case Lexer::TokenType::ID: // For object identifiers
-		node = new IDNode(lexer.getCurrToken().getLexeme(), pos);
+		node = arena.make<IDNode>(lexer.getCurrToken().getLexeme(), pos);
 		lexer.scanToken();
 		break;
 	default:
@@ -534,3 +538,20 @@ ASTNode* Parser::parsePrimary(precedenceGroup*)
 	}
 	return node;
 }
+
+ASTNode* Parser::makeList(std::vector<ASTNode*> elements, const size_t pos)
+{
+	// A list of literals (i.e. [3, 1, 45]) is built once, instead of every time it runs
+	std::vector<Object*> values;
+	for (const ASTNode* element : elements)
+	{
+		const auto* literal = dynamic_cast<const LiteralNode*>(element);
+		if (!literal)
+		{
+			return arena.make<nAryNode>(nullptr, OperatorType::LIST_INIT,
+			                            std::move(elements), pos);
+		}
+		values.push_back(const_cast<Object*>(&literal->getValue()));
+	}
+	return makeLiteral(makeRef<ArrayContainer>(values), pos);
+}
@@ -0,0 +1,65 @@
+/* pool.cpp */
+
+#include "pool.h"
+#include <new>
+
+thread_local Pool::SizeClass Pool::classes[N_CLASSES];
+thread_local size_t Pool::largeAllocs = 0;
+
+void* Pool::allocate(const size_t size)
+{
+	if (size > MAX_SIZE)
+	{
+		largeAllocs++;
+		return ::operator new(size);
+	}
+	const size_t idx = (size - 1) / GRANULARITY; // Size class of the block
+	SizeClass& sizeClass = classes[idx];
+	if (sizeClass.freeList) sizeClass.hits++;
+	else
+	{
+		sizeClass.misses++;
+		refill(sizeClass, (idx + 1) * GRANULARITY);
+	}
+	FreeBlock* block = sizeClass.freeList;
+	sizeClass.freeList = block->next;
+	return block;
+}
+
+void Pool::deallocate(void* ptr, const size_t size)
+{
+	if (!ptr) return;
+	if (size > MAX_SIZE)
+	{
+		::operator delete(ptr);
+		return;
+	}
+	SizeClass& sizeClass = classes[(size - 1) / GRANULARITY];
+	const auto block = static_cast<FreeBlock*>(ptr);
+	block->next = sizeClass.freeList; // The block is reused for the next allocation
+	sizeClass.freeList = block;
+}
+
+void Pool::refill(SizeClass& sizeClass, const size_t blockSize)
+{
+	// The slab is cut into blocks, which are all linked to the free list
+	const auto slab = static_cast<std::byte*>(::operator new(SLAB_SIZE));
+	for (size_t offset = 0; offset + blockSize <= SLAB_SIZE; offset += blockSize)
+	{
+		const auto block = reinterpret_cast<FreeBlock*>(slab + offset);
+		block->next = sizeClass.freeList;
+		sizeClass.freeList = block;
+	}
+}
+
+void Pool::printStats(std::ostream& os)
+{
+	os << "Pool statistics (size: hits / misses)\n";
+	for (size_t i = 0; i != N_CLASSES; i++)
+	{
+		if (!classes[i].hits && !classes[i].misses) continue; // Unused size class
+		os << '\t' << (i + 1) * GRANULARITY << " B: " << classes[i].hits << " / " <<
+			classes[i].misses << '\n';
+	}
+	os << "\tLarger: " << largeAllocs << '\n';
+}
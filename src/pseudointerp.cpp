@@ -7,9 +7,17 @@
 #include <chrono> // To measure runtime of code
 
 #include "AST.h"
+#include "bytecode.h"
+#include "closure.h"
+#include "fuser.h"
+#include "loops.h"
+#include "vm.h"
+#include "resolver.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "scope.h"
 #include "inputcleaner.h"
+#include "pool.h"
 #include "errors.h"
 /* This color lib only works with windows
  * #include "color.h" */
@@ -17,20 +25,54 @@
 #define VER "1.0" // Current version of the software
 
 
-void interpret(const std::string& inputStr)
+// useVM runs the program on the bytecode VM instead of the tree-walker, useClosures
+// runs it as a tree of closures, showBytecode prints the compiled program before
+// running it, optimize folds the constants before running it
+void interpret(const std::string& inputStr, const bool useVM, const bool useClosures,
+               const bool showBytecode, const bool optimize)
 {
 	InputCleaner cleaner(inputStr);
-        CodeBlock* mainBlock = nullptr;
 	try
 	{
 		Parser parser;
-		mainBlock = parser.getAST(cleaner.clean());
-		// Get the AST of the whole code
+		Program program = parser.getAST(cleaner.clean());
+		// Get the AST of the whole code. It must outlive the scope, whose functions
+		// point to its nodes
+		CodeBlock* mainBlock = program.mainBlock;
 		Scope globalScope;
 		globalScope.enableExternalFunctions();
 		// To have functions such as output(), input(), etc.
+		if (optimize)
+		{
+			Optimizer optimizer(globalScope, program.arena, program.constants);
+			optimizer.optimize(mainBlock);
+		}
+		LoopOptimizer loopOptimizer(globalScope, program.arena);
+		loopOptimizer.optimize(mainBlock); // Find the counted loops
+		Fuser fuser(program.arena);
+		fuser.fuse(mainBlock); // Replace the common trees with fused nodes
+		Resolver resolver(globalScope);
+		resolver.resolve(mainBlock); // Bind identifiers to their slots
+		std::unique_ptr<Proto> mainProto; // The bytecode, if it is needed
+		if (useVM || showBytecode)
+		{
+			Compiler compiler;
+			mainProto = compiler.compile(mainBlock);
+			if (showBytecode) std::cout << disassemble(*mainProto) << '\n';
+		}
+		// The closures, if they are needed. The compiler holds the bodies of the functions
+		ClosureCompiler closureCompiler;
+		StmtClosure mainClosure;
+		if (useClosures) mainClosure = closureCompiler.compile(mainBlock);
 		const auto start = std::chrono::high_resolution_clock::now();
-		mainBlock->eval(&globalScope, false);
+		if (useVM)
+		{
+			VM vm;
+			Object result; // The main program does not return anything
+			vm.run(*mainProto, &globalScope, result);
+		}
+		else if (useClosures) mainClosure(&globalScope, false);
+		else mainBlock->eval(&globalScope, false);
 		const auto stop = std::chrono::high_resolution_clock::now();
 		const auto duration = std::chrono::duration_cast<
 			std::chrono::milliseconds>(stop - start);
@@ -57,9 +99,6 @@ void interpret(const std::string& inputStr)
 		// Cleaner is responsible for accepting a position as a integer, and finding the
 		// exact line and character corresponding to that position.
 	}
-    
-    	if (mainBlock)
-                delete mainBlock;
 }
 
 int main(int argc, char** argv)
@@ -70,6 +109,11 @@ int main(int argc, char** argv)
 		unsigned int ver : 1 = 0; // Displays version
 		unsigned int inputFile : 1 = 0; // Accept the input file
 		unsigned int inputFileSet : 1 = 0; // 1 if file already set
+		unsigned int bytecode : 1 = 0; // Run on the bytecode VM
+		unsigned int closures : 1 = 0; // Run as a tree of closures
+		unsigned int disassemble : 1 = 0; // Print the compiled bytecode
+		unsigned int poolStats : 1 = 0; // Print the statistics of the object pool
+		unsigned int optimize : 1 = 0; // Optimization level
 	} flags;
 	std::string inputFilePath;
 	try
@@ -90,6 +134,23 @@ int main(int argc, char** argv)
 				case 'i':
 					flags.inputFile = 1;
 					break;
+				case 'b':
+					flags.bytecode = 1;
+					break;
+				case 'c':
+					flags.closures = 1;
+					break;
+				case 'd':
+					flags.disassemble = 1;
+					break;
+				case 'm':
+					flags.poolStats = 1;
+					break;
+				case 'o': // The level follows, i.e. -O1
+					if (argv[0][1] != '0' && argv[0][1] != '1')
+						throw std::runtime_error("Optimization level 0 or 1 expected.");
+					flags.optimize = *++argv[0] - '0';
+					break;
 				default:
 					throw std::runtime_error(
 						"Illegal command line argument: " + std::string(1, c));
@@ -112,11 +173,16 @@ int main(int argc, char** argv)
 		if (argc != 0) // If not all arguments detected throw error
 			throw std::runtime_error(
 				"Illegal command line arguments.");
+		if (flags.bytecode && flags.closures) // A single engine runs the program
+			throw std::runtime_error("Only one of -b and -c can be set.");
 		if (flags.help)
 			std::cout << // Print help message
 				"IB pseudocode interpreter made by Rafael Moschopoulos\n "
 				"Usage\t-? : Prints this message\n\t-I : Sets "
-				"input code file\n\t-V : Prints version number\n";
+				"input code file\n\t-V : Prints version number\n\t-B : Runs "
+				"on the bytecode VM\n\t-C : Runs as a tree of closures\n\t-D : Prints the compiled bytecode\n\t-M : Prints "
+				"the statistics of the object pool at exit\n\t-O1 : Folds the "
+				"constant expressions and variables\n";
 		if (flags.ver) std::cout << "Version " << VER << '\n'; // Show version
 
 		if (flags.inputFileSet)
@@ -127,8 +193,11 @@ int main(int argc, char** argv)
 					"Error opening file \"" + inputFilePath + "\"");
 			std::stringstream fileBuffer;
 			fileBuffer << inputFile.rdbuf(); // Read file into buffer
-			interpret(fileBuffer.str()); // Interpret code
+			interpret(fileBuffer.str(), flags.bytecode, flags.closures,
+			          flags.disassemble, flags.optimize);
+			// Interpret code
 			inputFile.close();
+			if (flags.poolStats) Pool::printStats(std::cout);
 		}
 	}
 	catch (std::runtime_error& re) // Report any errors occured
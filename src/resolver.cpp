@@ -0,0 +1,174 @@
+/* resolver.cpp */
+
+#include "resolver.h"
+#include "AST.h"
+
+Resolver::Resolver(const Scope& globalScope) : globalScope(globalScope)
+{
+}
+
+void Resolver::resolve(CodeBlock* mainBlock)
+{
+	units.push_back({{}, 1, false});
+	mainBlock->resolve(*this);
+	units.pop_back();
+}
+
+void Resolver::enterFunction()
+{
+	units.push_back({{}, 0, true});
+}
+
+void Resolver::exitFunction()
+{
+	units.pop_back();
+}
+
+void Resolver::enterFrame()
+{
+	units.back().frames.emplace_back();
+}
+
+size_t Resolver::exitFrame()
+{
+	const size_t nSlots = units.back().frames.back().slots.size();
+	units.back().frames.pop_back();
+	return nSlots;
+}
+
+Binding Resolver::bind(const std::string& id, const bool lSide)
+{
+	Unit& unit = units.back();
+	if (lSide) // The variable is created in the innermost frame if it doesn't exist
+	{
+		auto& slots = unit.frames.back().slots;
+		slots.try_emplace(id, static_cast<int>(slots.size()));
+	}
+
+	Binding binding;
+	binding.symbol = Scope::getSymbol(id);
+	for (int i = static_cast<int>(unit.frames.size()) - 1; i >= 0; i--)
+	{
+		const auto itr = unit.frames[i].slots.find(id);
+		if (itr != unit.frames[i].slots.end())
+			binding.slots.push_back({unit.firstDepth + i, itr->second});
+	}
+	binding.builtin = globalScope.getSlot(id, 0);
+	// The parameters are always new variables of the function
+	const bool isParam = lSide && unit.isFunction && unit.frames.size() == 1;
+	binding.dynamic = unit.isFunction && !isParam;
+	return binding;
+}
+
+void CodeBlock::resolve(Resolver& resolver)
+{
+	resolver.enterFrame();
+	for (Statement* st : statementVec)
+	{
+		st->resolve(resolver);
+	}
+	nSlots = resolver.exitFrame();
+}
+
+void Statement::resolve(Resolver&)
+{
+}
+
+void IfStatement::resolve(Resolver& resolver)
+{
+	for (const auto& [casePtr, blockPtr] : cases)
+	{
+		casePtr->resolve(resolver);
+		blockPtr->resolve(resolver);
+	}
+}
+
+void WhileStatement::resolve(Resolver& resolver)
+{
+	condition->resolve(resolver);
+	block->resolve(resolver);
+}
+
+void ForStatement::resolve(Resolver& resolver)
+{
+	lowerNode->resolve(resolver);
+	upperNode->resolve(resolver);
+	resolver.enterFrame(); // The counter's frame
+	counterNode->resolve(resolver, true);
+	block->resolve(resolver);
+	resolver.exitFrame();
+}
+
+void ExprStatement::resolve(Resolver& resolver)
+{
+	exprRoot->resolve(resolver);
+}
+
+void ReturnStatement::resolve(Resolver& resolver)
+{
+	returnRoot->resolve(resolver);
+}
+
+void FunctionDefStatement::resolve(Resolver& resolver)
+{
+	funcID->resolve(resolver, true);
+	resolver.enterFunction();
+	resolver.enterFrame(); // The parameters' frame
+	for (ASTNode* param : funcParams)
+	{
+		param->resolve(resolver, true);
+	}
+	block->resolve(resolver);
+	resolver.exitFrame();
+	resolver.exitFunction();
+}
+
+void ASTNode::resolve(Resolver&, bool)
+{
+}
+
+void nAryNode::resolve(Resolver& resolver, bool)
+{
+	// Same order as eval(), the operands first
+	for (ASTNode* node : nOperands)
+	{
+		node->resolve(resolver);
+	}
+	if (mainOperand) mainOperand->resolve(resolver);
+}
+
+void BinaryNode::resolve(Resolver& resolver, const bool lSide)
+{
+	if (opType == OperatorType::MEMBER_ACCESS)
+	{
+		// The method name is looked up in the methods of the object's type, by name
+		left->resolve(resolver);
+		return;
+	}
+	left->resolve(resolver, opType == OperatorType::ASSIGNMENT);
+	right->resolve(resolver, lSide);
+}
+
+void UnaryNode::resolve(Resolver& resolver, bool)
+{
+	operand->resolve(resolver);
+}
+
+void LiteralNode::resolve(Resolver&, bool)
+{
+}
+
+void IDNode::resolve(Resolver& resolver, const bool lSide)
+{
+	binding = resolver.bind(id, lSide);
+}
+
+void HoistedNode::resolve(Resolver& resolver, const bool lSide)
+{
+	expr->resolve(resolver, lSide);
+}
+
+void FusedNode::resolve(Resolver& resolver, const bool lSide)
+{
+	original->resolve(resolver, lSide); // The fused node shares its nodes
+}
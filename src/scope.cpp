@@ -1,120 +1,191 @@
 /* scope.cpp */
 
 #include "scope.h"
+#include "AST.h"
 #include "errors.h"
 #include <iostream>
-#include <ranges>
+#include <unordered_map>
 
 /*Initially some getters, setters and constrctors */
-Scope::ObjKey::ObjKey() = default;
+Scope::Scope() = default;
 
-Scope::ObjKey::ObjKey(const int scopeLevel, const int funcLevel,
-                      std::string ID) : scopeLevel(scopeLevel),
-                                        funcLevel(funcLevel), ID(std::move(ID))
+/* Used to increase/decrease levels*/
+int Scope::getLevel() const { return static_cast<int>(frames.size()) - 1; }
+int Scope::getFuncLevel() const { return funcLevel; }
+void Scope::incFuncLevel() { funcLevel++; }
+void Scope::decrFuncLevel() { funcLevel--; }
+
+void Scope::incLevel(const size_t nSlots)
 {
+	frames.push_back({entries.size(), funcLevel, getLevel(), 0});
+	entries.resize(entries.size() + nSlots); // Slots are empty until assigned to
 }
 
-Scope::Scope() = default;
-
-Scope::ObjMap& Scope::getMap()
+size_t Scope::getEnd(const size_t frame) const
 {
-	return scopeMap;
+	return (frame + 1 != frames.size()) ? (frames[frame + 1].start) : (entries.size());
 }
 
-/* Used to increase/decrease levels*/
-int Scope::getLevel() const { return scopeLevel; }
-int Scope::getFuncLevel() const { return funcLevel; }
-void Scope::incLevel() { scopeLevel++; }
-void Scope::incFuncLevel() { funcLevel++; }
-void Scope::decrFuncLevel() { funcLevel--; }
+void Scope::enterFunction(const int definedFuncLevel, const size_t nParams)
+{
+	// The function has access to the variables with a func level less or equal to the
+	// func level of its definition. The func level only decreases when going down from
+	// the top, so the caller's frames above those are skipped, as well as any empty
+	// frames (they hold nothing the function could access).
+	int env = getLevel();
+	while (env != 0 && (frames[env].funcLevel > definedFuncLevel ||
+		frames[env].nObjects == 0))
+	{
+		env = frames[env].parent;
+	}
+	calls.push_back({baseLevel, funcLevel});
+	funcLevel = frames[env].funcLevel + 1;
+	frames.push_back({entries.size(), funcLevel, env, 0});
+	entries.resize(entries.size() + nParams);
+	baseLevel = getLevel();
+}
 
-void Scope::setScopeLevel(const int level)
+void Scope::exitFunction()
 {
-	scopeLevel = level;
+	while (getLevel() >= baseLevel) decrLevel(); // Including the parameters' frame
+	baseLevel = calls.back().baseLevel;
+	funcLevel = calls.back().funcLevel;
+	calls.pop_back();
 }
 
-void Scope::setFuncLevel(const int level)
+bool Scope::isLocal(const Object* obj) const
 {
-	funcLevel = level;
+	if (calls.empty()) return false; // Not in a function
+	for (size_t i = frames[baseLevel].start; i != entries.size(); i++)
+	{
+		if (entries[i].obj == obj) return true;
+	}
+	return false;
 }
 
 void Scope::decrLevel()
 {
-	if (scopeLevel == 0)
+	if (frames.size() == 1)
 	{
 		throw FatalError("");
 	}
-	std::vector<ObjKey> toBeDeleted;
-	// Iterated in reverse since highest scopelevel is at the beginning.
-	// Keys of objects with current (highest) scopelevel are stored
-	for (auto& itr : std::ranges::reverse_view(scopeMap))
-	{
-		if (itr.first.scopeLevel == scopeLevel)
-		{
-			delete itr.second; // Delete the object
-			toBeDeleted.push_back(itr.first);
-		}
-	}
-	// Objects are deleted
-	for (const auto& x : toBeDeleted)
+	// Only the objects of the current (highest) scope level are deleted
+	const size_t start = frames.back().start;
+	for (size_t i = start; i != entries.size(); i++)
 	{
-		scopeMap.erase(x); // Remove keys of deleted objects
+		delete entries[i].obj;
 	}
-	scopeLevel--; // The level counter is decremented
+	entries.resize(start);
+	frames.pop_back(); // The level counter is decremented
+}
+
+static std::unordered_map<std::string, int>& symbolTable()
+{
+	static std::unordered_map<std::string, int> table;
+	return table;
+}
+
+int Scope::getSymbol(const std::string& id)
+{
+	auto& table = symbolTable();
+	return table.try_emplace(id, static_cast<int>(table.size())).first->second;
+}
+
+int Scope::findSymbol(const std::string& id)
+{
+	const auto& table = symbolTable();
+	const auto itr = table.find(id);
+	return (itr != table.end()) ? (itr->second) : (-1);
 }
 
 void Scope::addObj(const Object& obj, const std::string& id, bool isConst)
 {
-	Object* objPtr; // This will be the ponter of the new object
-	scopeMap[ObjKey(scopeLevel, funcLevel, id)] = objPtr = new Object(obj);
+	const auto objPtr = new Object(obj); // This will be the ponter of the new object
 	objPtr->setLval(true); // It is an lval since it exists in a scope
 	objPtr->setConst(isConst);
+	entries.push_back({getSymbol(id), objPtr}); // Added to the frame on top
+	frames.back().nObjects++;
 }
 
 void Scope::addObj(Object* obj, const std::string& id, bool isConst)
 {
-	// Objects are sorted by the first element of the key (highest to lowest scope level)
-	scopeMap[ObjKey(scopeLevel, funcLevel, id)] = obj;
+	entries.push_back({getSymbol(id), obj});
+	frames.back().nObjects++;
 	obj->setLval(true);
 	obj->setConst(isConst);
 	// To prevent user from reassigning built in functions like output()
 }
 
-Object* Scope::getObj(const std::string& id)
+Object* Scope::getObj(const int symbol)
 {
-	// Iterate in reverse, so that Objects with higher scopelevel are chosen first
-	for (auto& itr : std::ranges::reverse_view(scopeMap))
+	// Go down the frames, so that Objects with higher scopelevel are chosen first
+	for (int frame = getLevel(); frame != -1; frame = frames[frame].parent)
 	{
-		if (itr.first.ID == id) // For the first object with matching ID
+		for (size_t i = frames[frame].start; i != getEnd(frame); i++)
 		{
-			return itr.second; // Return it!
+			if (entries[i].symbol == symbol && entries[i].obj)
+				// For the first object with matching ID
+			{
+				return entries[i].obj; // Return it!
+			}
 		}
 	}
 	return nullptr;
 }
 
+Object* Scope::getObj(const std::string& id)
+{
+	const int symbol = findSymbol(id);
+	return (symbol >= 0) ? (getObj(symbol)) : (nullptr);
+}
+
 bool Scope::checkObj(const std::string& id)
 {
 	return getObj(id); // If getObj returns nullptr, the object doesn't exist
 }
 
-Scope* Scope::getRestricted(const int maxFuncLevel)
+Object* Scope::getObj(const Binding& binding, const std::string& id)
+{
+	for (const auto& [depth, slot] : binding.slots)
+	{
+		// The first non-empty slot is the one with the highest scope level
+		if (Object* obj = entries[frames[baseLevel + depth].start + slot].obj)
+			return obj;
+	}
+	if (binding.builtin >= 0) return entries[binding.builtin].obj;
+	if (binding.dynamic)
+		return (binding.symbol >= 0) ? (getObj(binding.symbol)) : (getObj(id));
+	return nullptr;
+}
+
+Object* Scope::getOrAddObj(const Binding& binding, const std::string& id)
+{
+	if (Object* obj = getObj(binding, id)) return obj;
+	if (binding.slots.empty()) // Not resolved, it goes to the current level
+	{
+		addObj(Object(), id);
+		return entries.back().obj;
+	}
+	// The first candidate is in the frame where the resolver declared the variable
+	const auto& [depth, slot] = binding.slots[0];
+	Frame& frame = frames[baseLevel + depth];
+	Entry& entry = entries[frame.start + slot];
+	entry = {binding.symbol, new Object};
+	frame.nObjects++;
+	entry.obj->setLval(true);
+	return entry.obj;
+}
+
+int Scope::getSlot(const std::string& id, const int level) const
 {
-	// Creates a new scope, containing all variables of the existing scope that have a
-	// func level less or equal to maxFuncLevel
-	const auto newScope = new Scope;
-	ObjMap& newMap = newScope->getMap(); // The map of the new scope
-	for (auto& itr : scopeMap)
+	// Finds the slot of an object that was added by name (i.e. the hardcoded ones)
+	const int symbol = findSymbol(id);
+	for (size_t i = frames[level].start; i != getEnd(level); i++)
 	{
-		if (itr.first.funcLevel <= maxFuncLevel) 
-			// If current obj's level is low enough, include it
-			newMap.insert(itr);
-		else // When level max level is surpassed, there's no point in continuing
-			break;
+		if (entries[i].symbol == symbol && entries[i].obj)
+			return static_cast<int>(i - frames[level].start);
 	}
-	newScope->setFuncLevel(newMap.rbegin()->first.funcLevel);
-	newScope->setScopeLevel(newMap.rbegin()->first.scopeLevel);
-	return newScope;
+	return -1;
 }
 
 #include <type_traits>
@@ -152,17 +223,16 @@ void Scope::enableExternalFunctions()
 // called to construct data structures, or to use output(), input(), etc
 {
 	// The object's values are lambdas
-	addObj(Object([](const std::vector<Object*>& argVec)  // Array constructor
+	addObj(Object([](Args argVec)  // Array constructor
 	{
 			// Some argument checking
 		if (argVec.empty()) throw ArgumentError(
 			"At least 1 array size parameter expected.");
-		size_t currSize = 0;
 		std::vector<size_t> dimVec(argVec.size()); // Will hold array dimensions
 		for (size_t i = 0; i != dimVec.size(); i++)
 		{
 			// If the argument is an int
-			if (const int* size = std::get_if<int>(&argVec[0]->data))
+			if (const int* size = std::get_if<int>(&argVec[i]->data))
 			{
 				if (*size > 0) dimVec[i] = static_cast<size_t>(*size);
 				// Dimension must be positive
@@ -172,27 +242,27 @@ void Scope::enableExternalFunctions()
 			else throw TypeError("Array size parameter must be an integer.");
 		}
 
-		return new Object(std::make_shared<ArrayContainer>(dimVec));
+		return new Object(makeRef<ArrayContainer>(dimVec));
 	}), "Array", true);
 
-	addObj(Object([](const std::vector<Object*>& argVec) // Stack constructor
+	addObj(Object([](Args argVec) // Stack constructor
 	{
 			// Simply return an empty stack object
-		return new Object(std::make_shared<StackContainer>(argVec)); 
+		return new Object(makeRef<StackContainer>(argVec)); 
 	}), "Stack", true);
-	addObj(Object([](const std::vector<Object*>& argVec) // Queue constructor
+	addObj(Object([](Args argVec) // Queue constructor
 	{
-		return new Object(std::make_shared<QueueContainer>(argVec));
+		return new Object(makeRef<QueueContainer>(argVec));
 	}), "Queue", true);
-	addObj(Object([](const std::vector<Object*>& argVec) // Collection constructor
+	addObj(Object([](Args argVec) // Collection constructor
 	{
-		return new Object(std::make_shared<CollectionContainer>(argVec));
+		return new Object(makeRef<CollectionContainer>(argVec));
 	}), "Collection", true);
-	addObj(Object([](const std::vector<Object*>& argVec) // String constructor
+	addObj(Object([](Args argVec) // String constructor
 	{
-		return new Object(std::make_shared<StringContainer>(argVec));
+		return new Object(makeRef<StringContainer>(argVec));
 	}), "String", true);
-	addObj(Object([](const std::vector<Object*>& argVec) // output() function
+	addObj(Object([](Args argVec) // output() function
 	{
 		for (Object* obj : argVec) // Get string representation of arguments
 		{
@@ -201,7 +271,7 @@ void Scope::enableExternalFunctions()
 		std::cout << '\n'; // newline at the end
 		return new Object(0); // 0 signifies no error
 	}), "output", true);
-	addObj(Object([](const std::vector<Object*>& argVec) // input() function
+	addObj(Object([](Args argVec) // input() function
 	{
 		// input(a) and a = input() are equivalent.
 		// Hard coded functions have the luxury to support pass by reference!
@@ -217,7 +287,7 @@ void Scope::enableExternalFunctions()
 			str_to_numerical(inputStr, inputFloat)) // If it's a valid float
 			inputObj = new Object(inputFloat); // Create float object
 		else // Else just create a string object loaded with the input string
-			inputObj = new Object(std::make_shared<StringContainer>(inputStr));
+			inputObj = new Object(makeRef<StringContainer>(inputStr));
 		if (argVec.size() == 1)
 			// If you pass an argument to input(), then the input value is put in that
 			// argument
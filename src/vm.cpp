@@ -0,0 +1,457 @@
+/* vm.cpp */
+
+#include "vm.h"
+#include "AST.h"
+#include "errors.h"
+#include <algorithm>
+#include <array>
+
+// The operators of the binary instructions that try two ints and two floats before the
+// generic operator, like a quickened node (see numericalOperator()), by opcode
+static const auto numericalOperators = []
+{
+	std::array<BinaryOperator, static_cast<size_t>(OpCode::HALT) + 1> operators{};
+	const std::pair<OpCode, OperatorType> pairs[] = {
+		{OpCode::ADD, OperatorType::ADDITION}, {OpCode::SUB, OperatorType::SUBTRACTION},
+		{OpCode::MUL, OperatorType::MULTIPLICATION}, {OpCode::DIV, OperatorType::DIVISION},
+		{OpCode::LESS, OperatorType::LESS}, {OpCode::LESS_EQ, OperatorType::LESS_EQ},
+		{OpCode::GREATER, OperatorType::GREATER}, {OpCode::GRE_EQ, OperatorType::GRE_EQ},
+		{OpCode::EQUAL, OperatorType::EQUAL}, {OpCode::NOT_EQUAL, OperatorType::NOT_EQUAL},
+		{OpCode::ADD_ASSIGN, OperatorType::ADDITION_ASSIGN},
+		{OpCode::SUB_ASSIGN, OperatorType::SUBTRACTION_ASSIGN}
+	};
+	for (const auto& [op, opType] : pairs)
+	{
+		operators[static_cast<size_t>(op)] = numericalOperator(opType);
+	}
+	return operators;
+}();
+
+VM::Register::Register() = default;
+
+VM::Register::Register(Register&& reg2) noexcept : ref(reg2.ref)
+{
+	// Moving the data keeps the containers in place, so refs to their elements stay valid
+	value.data = std::move(reg2.value.data);
+}
+
+VM::VM() = default;
+
+Object* VM::get(Register& reg)
+{
+	return (reg.ref) ? (reg.ref) : (&reg.value);
+}
+
+Object* VM::operand(Register& reg)
+{
+	Object* obj = get(reg);
+	if (obj == &voidObject) { throw FatalError(""); } // Like a nullptr in eval()
+	return obj;
+}
+
+void VM::setValue(Register& reg, Object&& obj)
+{
+	// Temporaries are moved into the register instead of being allocated
+	reg.value.data = std::move(obj.data);
+	reg.ref = nullptr;
+}
+
+void VM::setChanged(Register& reg, Object& changed)
+{
+	if (!changed.isProxy())
+	{
+		reg.ref = &changed;
+		return;
+	}
+	// An element of a packed array is stored back, and the register keeps its value
+	Object value(changed);
+	changed.storeBack();
+	setValue(reg, std::move(value));
+}
+
+void VM::applyNumerical(Register& reg, const OpCode op, Register& left, Register& right)
+{
+	const BinaryOperator apply = numericalOperators[static_cast<size_t>(op)];
+	// The value of the register is the temporary that holds the result
+	Object* result = apply(operand(left), operand(right), rightTmp, reg.value);
+	if (result == &reg.value) reg.ref = nullptr;
+	else setChanged(reg, *result); // An assignment, whose result is the lhs operand
+}
+
+void VM::callMethod(Register& reg, const MethodCall& site, const uint32_t nArgs)
+{
+	Object* receiver = operand(reg);
+	if (receiver->data.index() != site.cachedType) // Missed the inline cache
+	{
+		Method method = nullptr;
+		try
+		{
+			method = findMethod(*receiver, site.name);
+		}
+		catch (CustomError& ce)
+		{
+			if (!ce.isPosSet()) ce.setPos(site.pos);
+			throw;
+		}
+		if (!method)
+		{
+			throw NameError("Object with identifier \'" + site.name +
+			                "\' does not exist in scope.", site.namePos);
+		}
+		site.cachedType = receiver->data.index();
+		site.cachedMethod = method;
+	}
+	argBuffer.clear();
+	for (uint32_t i = 1; i <= nArgs; i++)
+	{
+		argBuffer.push_back(operand((&reg)[i]));
+	}
+	// The receiver stays in the register until the method returns
+	Object* result = site.cachedMethod(*receiver, argBuffer);
+	if (!result) // Methods like push() return nothing
+	{
+		reg.ref = &voidObject;
+		return;
+	}
+	setValue(reg, std::move(*result));
+	delete result;
+}
+
+void VM::call(const size_t reg, const uint32_t nArgs, Scope* scope)
+{
+	argBuffer.clear();
+	for (size_t i = reg + 1; i != reg + 1 + nArgs; i++)
+	{
+		argBuffer.push_back(operand(registers[i]));
+	}
+	Object* callee = operand(registers[reg]);
+	const auto* funcRef = std::get_if<Ref<Function>>(&callee->data);
+	const Function* func = (funcRef) ? (funcRef->get()) : (nullptr);
+	if (func && func->getProto())
+	{
+		// Compiled methods run on the VM, in a register window above the caller's
+		const Proto* methodProto = func->getProto();
+		func->bindArgs(scope, argBuffer);
+		Object funcResult;
+		try
+		{
+			run(*methodProto, scope, funcResult);
+		}
+		catch (CustomError&)
+		{
+			scope->exitFunction();
+			throw;
+		}
+		scope->exitFunction();
+		setValue(registers[reg], std::move(funcResult));
+		return;
+	}
+	Object* result = (*callee)(scope, argBuffer);
+	if (!result) // Methods like push() return nothing
+	{
+		registers[reg].ref = &voidObject;
+		return;
+	}
+	setValue(registers[reg], std::move(*result));
+	delete result;
+}
+
+void VM::run(const Proto& proto, Scope* scope, Object& result)
+{
+	const size_t base = top;
+	top += proto.nRegs;
+	if (registers.size() < top)
+		registers.resize(std::max(top, 2 * registers.size()));
+	Register* R = registers.data() + base; // The unit's register window
+	const int baseLevel = scope->getLevel(); // To unwind blocks when returning
+	const size_t writeMark = WriteLocks::mark(); // The locks of the caller stay
+	size_t pc = 0;
+	try
+	{
+		while (true)
+		{
+			const Instruction& ins = proto.code[pc++];
+			switch (ins.op)
+			{
+			case OpCode::LOAD_CONST:
+				{
+					Object constant(proto.constants[ins.b]);
+					setValue(R[ins.a], std::move(constant));
+					break;
+				}
+			case OpCode::LOAD_NAME:
+				{
+					const IDNode& idNode = *proto.ids[ins.b];
+					R[ins.a].ref = scope->getObj(idNode.getBinding(), idNode.getID());
+					if (!R[ins.a].ref)
+					{
+						throw NameError( // Same error as IDNode::eval
+							"Object with identifier \'" + idNode.getID() +
+							"\' does not exist in scope.");
+					}
+					break;
+				}
+			case OpCode::DEF_NAME:
+				{
+					const IDNode& idNode = *proto.ids[ins.b];
+					R[ins.a].ref = scope->getOrAddObj(idNode.getBinding(),
+					                                  idNode.getID());
+					break;
+				}
+			case OpCode::COPY:
+				{
+					Object copy(*operand(R[ins.b]));
+					setValue(R[ins.a], std::move(copy));
+					break;
+				}
+			case OpCode::MOVE:
+				R[ins.a].ref = R[ins.b].ref;
+				std::swap(R[ins.a].value.data, R[ins.b].value.data);
+				break;
+			case OpCode::SELECT:
+				if (R[ins.b].ref && !operand(R[ins.b])->isLval())
+				{ // An rvalue that is not owned by the register has to be copied
+					Object copy(*R[ins.b].ref);
+					setValue(R[ins.a], std::move(copy));
+				}
+				else
+				{
+					R[ins.a].ref = R[ins.b].ref;
+					std::swap(R[ins.a].value.data, R[ins.b].value.data);
+				}
+				break;
+			case OpCode::NOT_VOID:
+				operand(R[ins.a]);
+				break;
+			// Two ints or two floats are handled directly
+			case OpCode::ADD:
+			case OpCode::SUB:
+			case OpCode::MUL:
+			case OpCode::DIV:
+			case OpCode::LESS:
+			case OpCode::LESS_EQ:
+			case OpCode::GREATER:
+			case OpCode::GRE_EQ:
+			case OpCode::EQUAL:
+			case OpCode::NOT_EQUAL:
+			case OpCode::ADD_ASSIGN:
+			case OpCode::SUB_ASSIGN:
+				applyNumerical(R[ins.a], ins.op, R[ins.b], R[ins.c]);
+				break;
+			case OpCode::MOD:
+				setValue(R[ins.a], *operand(R[ins.b]) % *operand(R[ins.c]));
+				break;
+			case OpCode::INT_DIV:
+				setValue(R[ins.a],
+				         operatorDiv(*operand(R[ins.b]), *operand(R[ins.c])));
+				break;
+			case OpCode::OR:
+				setValue(R[ins.a], *operand(R[ins.b]) || *operand(R[ins.c]));
+				break;
+			case OpCode::AND:
+				setValue(R[ins.a], *operand(R[ins.b]) && *operand(R[ins.c]));
+				break;
+			// The result of an assignment is the lhs operand, which must be an lval
+			case OpCode::ASSIGN:
+				setChanged(R[ins.a],
+				           checkLval(*operand(R[ins.b]) = *operand(R[ins.c])));
+				break;
+			case OpCode::MUL_ASSIGN:
+				setChanged(R[ins.a],
+				           checkLval(*operand(R[ins.b]) *= *operand(R[ins.c])));
+				break;
+			case OpCode::DIV_ASSIGN:
+				setChanged(R[ins.a],
+				           checkLval(*operand(R[ins.b]) /= *operand(R[ins.c])));
+				break;
+			case OpCode::MOD_ASSIGN:
+				setChanged(R[ins.a],
+				           checkLval(*operand(R[ins.b]) %= *operand(R[ins.c])));
+				break;
+			case OpCode::INT_DIV_ASSIGN:
+				setChanged(R[ins.a], checkLval(
+					operand(R[ins.b])->operatorDivEq(*operand(R[ins.c]))));
+				break;
+			case OpCode::NOT:
+				setValue(R[ins.a], !*operand(R[ins.b]));
+				break;
+			case OpCode::NEGATE:
+				setValue(R[ins.a], -*operand(R[ins.b]));
+				break;
+			case OpCode::PLUS:
+				setValue(R[ins.a], +*operand(R[ins.b]));
+				break;
+			case OpCode::PRE_INCR: // The prefix operators return an lval
+				setChanged(R[ins.a], checkLval(++*operand(R[ins.b])));
+				break;
+			case OpCode::PRE_DECR:
+				setChanged(R[ins.a], checkLval(--*operand(R[ins.b])));
+				break;
+			case OpCode::POST_INCR:
+				{
+					Object* obj = operand(R[ins.b]);
+					checkLval(*obj);
+					Object old = (*obj)++;
+					obj->storeBack();
+					setValue(R[ins.a], std::move(old));
+					break;
+				}
+			case OpCode::POST_DECR:
+				{
+					Object* obj = operand(R[ins.b]);
+					checkLval(*obj);
+					Object old = (*obj)--;
+					obj->storeBack();
+					setValue(R[ins.a], std::move(old));
+					break;
+				}
+			case OpCode::GET_METHOD:
+				{
+					Object* receiver = operand(R[ins.a]);
+					const Method method = findMethod(*receiver, proto.names[ins.b]);
+					if (!method)
+					{
+						throw NameError(
+							"Object with identifier \'" + proto.names[ins.b] +
+							"\' does not exist in scope.", ins.c);
+					}
+					Object bound(bindMethod(*receiver, method));
+					setValue(R[ins.a], std::move(bound));
+					break;
+				}
+			case OpCode::CALL:
+				call(base + ins.a, ins.c, scope);
+				R = registers.data() + base; // The registers may have been moved
+				// The arguments may have been changed, i.e. input(A[0])
+				for (uint32_t i = ins.c; i >= 1; i--) get(R[ins.a + i])->storeBack();
+				break;
+			case OpCode::CALL_METHOD:
+				callMethod(R[ins.a], proto.methodCalls[ins.b], ins.c);
+				break;
+			case OpCode::SUBSCRIPT:
+				argBuffer.clear();
+				for (uint32_t i = 1; i <= ins.c; i++)
+				{
+					argBuffer.push_back(operand(R[ins.a + i]));
+				}
+				if (ins.b) R[ins.a].ref = operand(R[ins.a])->getWritable(argBuffer);
+				else
+				{
+					// The element may belong to a container held by the register
+					// itself, so a copied one is moved in after the lookup
+					Object element;
+					Object* result = operand(R[ins.a])->getElement(argBuffer, element);
+					if (result == &element) setValue(R[ins.a], std::move(element));
+					else R[ins.a].ref = result;
+				}
+				break;
+			case OpCode::SUBSCRIPT_CHAIN:
+				{
+					argBuffer.clear();
+					for (uint32_t i = 1; i <= ins.c; i++)
+					{
+						argBuffer.push_back(operand(R[ins.a + i]));
+					}
+					Object element;
+					Object* result = proto.subscripts[ins.b]->subscript(
+						operand(R[ins.a]), argBuffer, element);
+					if (result == &element) setValue(R[ins.a], std::move(element));
+					else R[ins.a].ref = result;
+				}
+				break;
+			case OpCode::LIST:
+				{
+					argBuffer.clear();
+					for (uint32_t i = 1; i <= ins.c; i++)
+					{
+						argBuffer.push_back(operand(R[ins.a + i]));
+					}
+					Object list(makeRef<ArrayContainer>(argBuffer));
+					setValue(R[ins.a], std::move(list));
+					break;
+				}
+			case OpCode::JUMP:
+				pc = ins.c;
+				break;
+			case OpCode::JUMP_IF_FALSE:
+				if (!operand(R[ins.a])->isTrue()) pc = ins.c;
+				break;
+			case OpCode::ENTER_BLOCK:
+				scope->incLevel(ins.b);
+				break;
+			case OpCode::EXIT_BLOCK:
+				scope->decrLevel();
+				break;
+			case OpCode::FOR_CHECK:
+				if ((*operand(R[ins.a]) > *operand(R[ins.b])).isTrue())
+					throw ValueError("Lower limit greater than upper limit.",
+					                 ins.c);
+				break;
+			case OpCode::SET:
+				*get(R[ins.a]) = *operand(R[ins.b]);
+				break;
+			case OpCode::INCR:
+				++*get(R[ins.a]);
+				break;
+			case OpCode::FOR_LOOP:
+				{
+					// Like countedLoop(): an int counter is incremented and compared
+					// directly in its slot
+					Object& counter = *get(R[ins.a]);
+					Object& upper = *operand(R[ins.b]);
+					int* i = std::get_if<int>(&counter.data);
+					if (i) ++*i;
+					else ++counter;
+					const int* last = std::get_if<int>(&upper.data);
+					if ((i && last) ? (*i <= *last) : (counter <= upper).isTrue())
+						pc = ins.c;
+					break;
+				}
+			case OpCode::FUNCTION:
+				{
+					// The function knows which variables it can access when it runs
+					const Proto& unit = *proto.protos[ins.b];
+					Object func(Function(unit.block, unit.params,
+					                     scope->getFuncLevel(), &unit));
+					setValue(R[ins.a], std::move(func));
+					break;
+				}
+			case OpCode::RETURN:
+				{
+					// Copies the return value. A temporary, or a variable of the method
+					// (which is freed on return), is moved instead
+					Object* returnObj = operand(R[ins.a]);
+					if (returnObj == &R[ins.a].value || scope->isLocal(returnObj))
+						result.data = std::move(returnObj->data);
+					else result = *returnObj;
+				}
+				while (scope->getLevel() > baseLevel) scope->decrLevel();
+				[[fallthrough]];
+			case OpCode::HALT:
+				WriteLocks::release(writeMark);
+				for (size_t i = base; i != top; i++)
+				{
+					// Release the values held by the window
+					registers[i].ref = nullptr;
+					registers[i].value.data = 0;
+				}
+				top = base;
+				return;
+			case OpCode::RELEASE_LOCKS:
+				WriteLocks::release(writeMark);
+				break;
+			case OpCode::RETURN_ERROR:
+				throw CustomError(
+					"Return statements should only be inside functions.");
+			}
+		}
+	}
+	catch (CustomError& ce)
+	{
+		// Like the nodes, an instruction sets the error's position if it's not set
+		if (!ce.isPosSet() && proto.positions[pc - 1] != NO_POS)
+			ce.setPos(proto.positions[pc - 1]);
+		top = base;
+		throw;
+	}
+}